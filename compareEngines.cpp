@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+#include "engineHarness.h"
+#include "wordle.h"
+#include "wordleLoop.h"
+#include "wordleRegression.h"
+
+using namespace std;
+const string allowedFilepath = "res/3b1b/allowed_words.txt";
+const string possibleFilepath = "res/3b1b/possible_words.txt";
+const string cacheFilepath = "entropy_cache.txt";
+
+// Usage: CompareEngines [random games = 1000] [seed = 1] [opening guesses...]
+// Plays the opening guesses (slate by default) against every answer and the
+// random games through every engine, reports where they disagree and how
+// fast each one is. Exits with 1 if any engine disagrees with Wordle
+int main(int argc, char *argv[])
+{
+    int games = argc > 1 ? stoi(argv[1]) : 1000;
+    uint64_t seed = argc > 2 ? stoull(argv[2]) : 1;
+    vector<string> openers(argv + min(argc, 3), argv + argc);
+    if (openers.empty()) openers = { "slate" };
+
+    Wordle wordle(allowedFilepath, possibleFilepath, cacheFilepath);
+    WordleLoop loop(allowedFilepath, possibleFilepath, cacheFilepath);
+    WordleRegression regression(allowedFilepath, possibleFilepath, cacheFilepath);
+
+    EngineHarness harness;
+    harness.add("Wordle", wordle);
+    harness.add("WordleLoop", loop);
+    harness.add("WordleRegression", regression);
+    cout << "Playing " << openers.size()
+         << " opening guesses against every answer..." << endl;
+    harness.runExhaustive(openers, 8, seed);
+    cout << "Playing " << games << " random games..." << endl;
+    harness.runRandom(games, 8, seed);
+    harness.printReport();
+    return harness.getMismatches().empty() ? 0 : 1;
+}
@@ -4,8 +4,9 @@ using namespace std;
 
 void ProgressBar::update(ull progress)
 {
-    int pos = (width * progress) / total;
-    int percent = (100 * progress) / total;
+    // nothing to do is done
+    int pos = total ? (width * progress) / total : width;
+    int percent = total ? (100 * progress) / total : 100;
     if (pos == lastPos && percent == lastPercent) return;
     lastPos = pos, lastPercent = percent;
 
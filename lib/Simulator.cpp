@@ -1,8 +1,11 @@
 #include "Simulator.h"
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include "ProgressBar.h"
+#include "batchEvaluator.h"
 
 Simulator::Simulator(const string &filepath, Wordle &wordle) : wordle(wordle)
 {
@@ -15,40 +18,214 @@ Simulator::Simulator(const string &filepath, Wordle &wordle) : wordle(wordle)
 
     string word;
     while (file >> word) words.push_back(word);
+    setShard(0, 1);
+}
+
+void Simulator::setShard(int index, int count)
+{
+    shardIndex = index, shardCount = count;
+    targets.clear();
+    for (int i = index; i < words.size(); i += count) targets.push_back(i);
+}
+
+void Simulator::setSeed(uint64_t seed)
+{
+    seeded = true, this->seed = seed;
+    wordle.setSeed(seed);
 }
 
 void Simulator::run(int n)
 {
-    ProgressBar progressBar(words.size());
-    int scores[7] = { 0 };
-    double averageScore = 0;
-    vector<string> lostWords;
-    vector<pair<double, int>> points;
-    for (int i = 0; i < words.size(); i++)
+    ProgressBar progressBar(targets.size());
+    vector<Game> games(words.size());
+    for (int i = 0; i < targets.size(); i++)
     {
-        wordle.reset();
-        wordle.setTargetWord(words[i]);
-
         progressBar.update(i);
-        vector<double> remainingBits;
-        remainingBits.push_back(wordle.getStat(-1).remainingBits);
-        while (!wordle.isGameOver())
+        play(wordle, targets[i], n, games[targets[i]]);
+    }
+    progressBar.finish();
+    finish(games);
+}
+
+void Simulator::play(Wordle &game, int target, int n, Game &result) const
+{
+    start(game, target, result);
+    while (!game.isGameOver()) turn(game, n, result);
+}
+
+void Simulator::start(Wordle &game, int target, Game &result) const
+{
+    game.reset();
+    game.setTargetWord(words[target]);
+    result.remainingBits.push_back(game.getStat(-1).remainingBits);
+}
+
+/**
+ * @brief Make the best guess of a game, and score it once it is over
+ */
+void Simulator::turn(Wordle &game, int n, Game &result) const
+{
+    auto guess = game.getTopNWords(n)[0];
+    auto stat = game.guess(guess.word);
+    result.remainingBits.push_back(stat.remainingBits);
+    if (!game.isGameOver()) return;
+    result.remainingBits.pop_back();
+
+    result.score = game.getGuesses();
+    if (game.getStatus() == Wordle::GameStatus::LOST) result.score = 7;
+}
+
+/**
+ * @brief Same policy as run, but a batch of games is played in lockstep, a
+ * turn at a time, so that the guesses they evaluate in a turn are evaluated
+ * together, see BatchEvaluator. Every game of the batch plays on a copy of
+ * the engine, the copies share its caches
+ *
+ * @param n words ranked per state
+ * @param batchSize games played at once
+ */
+void Simulator::runBatched(int n, int batchSize)
+{
+    ProgressBar progressBar(targets.size());
+    vector<Game> games(words.size());
+    for (int first = 0; first < targets.size(); first += batchSize)
+    {
+        int end = min<int>(first + batchSize, targets.size());
+        BatchEvaluator evaluator(wordle);
+        vector<pair<shared_ptr<Wordle>, int>> batch;
+        for (int i = first; i < end; i++)
         {
-            auto guess = wordle.getTopNWords(n)[0];
-            auto stat = wordle.guess(guess.word);
-            remainingBits.push_back(stat.remainingBits);
+            auto game = wordle.clone();
+            game->setEvaluator(evaluator.getEvaluator());
+            start(*game, targets[i], games[targets[i]]);
+            batch.push_back({ game, targets[i] });
         }
-        remainingBits.pop_back();
 
-        int score = wordle.getGuesses();
-        if (wordle.getStatus() == Wordle::GameStatus::LOST)
+        while (!batch.empty())
         {
-            score = 7;
-            lostWords.push_back(words[i]);
+            // a game waiting for its guesses has not guessed yet, it ranks
+            // again once the requests of the whole batch are evaluated
+            evaluator.startTurn();
+            vector<pair<shared_ptr<Wordle>, int>> waiting = batch;
+            do
+            {
+                erase_if(waiting, [&](auto &game) {
+                    try
+                    {
+                        turn(*game.first, n, games[game.second]);
+                        return true;
+                    }
+                    catch (const BatchEvaluator::Pending &)
+                    {
+                        return false;
+                    }
+                });
+            } while (evaluator.flush());
+
+            erase_if(batch, [](auto &game) { return game.first->isGameOver(); });
+            progressBar.update(end - batch.size());
         }
+    }
+    progressBar.finish();
+    finish(games);
+}
+
+/**
+ * @brief Same results as run, but games that reach the same state are played
+ * together. The targets are split by the pattern of each guess, so every
+ * state of the decision tree is ranked once however many targets reach it.
+ * Adversarial games do not depend on the target, they are played one by one
+ *
+ * @param n words ranked per state
+ */
+void Simulator::runTree(int n)
+{
+    if (wordle.getGameMode() == Wordle::GameMode::ADVERSARIAL) return run(n);
+
+    ProgressBar progressBar(targets.size());
+    progressBar.update(0);
+    vector<Game> games(words.size());
+    vector<string> history;
+    int done = 0;
+    if (!targets.empty()) expand(n, history, targets, games, progressBar, done);
+    progressBar.finish();
+
+    wordle.reset();
+    finish(games);
+}
+
+/**
+ * @brief Play the state reached by the guesses for every target in it
+ */
+void Simulator::expand(int n,
+                       vector<string> &history,
+                       const vector<int> &targets,
+                       vector<Game> &games,
+                       ProgressBar &progressBar,
+                       int &done)
+{
+    // the state only depends on the patterns, any of the targets reaches it
+    wordle.reset();
+    wordle.setTargetWord(words[targets[0]]);
+    for (auto &guess : history) wordle.guess(guess);
+
+    if (wordle.isGameOver())
+    {
+        for (auto &target : targets) games[target].score = 7;
+        progressBar.update(done += targets.size());
+        return;
+    }
+
+    double remainingBits = wordle.getStat(-1).remainingBits;
+    for (auto &target : targets)
+        games[target].remainingBits.push_back(remainingBits);
+
+    auto guess = wordle.getTopNWords(n)[0].word;
+    map<string, vector<int>> children;
+    for (auto &target : targets)
+        children[Wordle::getPattern(guess, words[target])].push_back(target);
+
+    history.push_back(guess);
+    for (auto &[pattern, group] : children)
+    {
+        if (pattern != string(pattern.size(), Wordle::TileType::CORRECT))
+        {
+            expand(n, history, group, games, progressBar, done);
+            continue;
+        }
+        for (auto &target : group) games[target].score = history.size();
+        progressBar.update(done += group.size());
+    }
+    history.pop_back();
+}
+
+/**
+ * @brief Report the games that were played and write them out
+ */
+void Simulator::finish(const vector<Game> &games) const
+{
+    report(words, games, pointsPath);
+    if (!partialPath.empty() && !writePartial(partialPath, games))
+        cerr << "Error writing partial results: " << partialPath << endl;
+}
+
+void Simulator::report(const vector<string> &words,
+                       const vector<Game> &games,
+                       const string &pointsPath)
+{
+    int scores[7] = { 0 }, played = 0;
+    double averageScore = 0;
+    vector<string> lostWords;
+    vector<pair<double, int>> points;
+    for (int i = 0; i < words.size(); i++)
+    {
+        int score = games[i].score;
+        if (!score) continue;
+        if (score == 7) lostWords.push_back(words[i]);
         scores[score - 1]++;
         averageScore += score;
-        for (auto &remainingBit : remainingBits)
+        played++;
+        for (auto &remainingBit : games[i].remainingBits)
         {
             points.push_back({ remainingBit, score-- });
             if (points.back().first == 0 && points.back().second > 1)
@@ -58,9 +235,11 @@ void Simulator::run(int n)
             }
         }
     }
-    progressBar.finish();
 
-    cout << "Average score: " << averageScore / words.size() << endl;
+    // a shard can have no targets
+    cout << "Average score: ";
+    if (played) cout << averageScore / played << endl;
+    else cout << "no games played" << endl;
     cout << "Scores: ";
     for (int i = 0; i < 7; i++) cout << scores[i] << " ";
     cout << endl;
@@ -71,7 +250,170 @@ void Simulator::run(int n)
         cout << endl;
     }
 
-    ofstream file("points.txt", ios::trunc);
+    if (pointsPath.empty()) return;
+    ofstream file(pointsPath, ios::trunc);
     for (auto &point : points)
         file << setprecision(18) << point.first << "," << point.second << endl;
 }
+
+namespace {
+const uint64_t PARTIAL_MAGIC = 0x5753494d50415254ull;  // "WSIMPART"
+const uint32_t PARTIAL_VERSION = 2;
+// a list of five letter words holds each of the 26^5 at most once
+const uint32_t PARTIAL_MAX_WORDS = 11881376;
+
+// FNV-1a of the words in order, tells the lists of two runs apart
+uint64_t fingerprint(const vector<string> &words)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto &word : words)
+        for (unsigned char c : word + '\n') hash = (hash ^ c) * 0x100000001b3ull;
+    return hash;
+}
+
+template <typename T>
+void put(ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+bool get(istream &in, T &value)
+{
+    return bool(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+}  // namespace
+
+/**
+ * @brief Write the played games in binary, in the byte order of this machine:
+ * a header with the fingerprint and size of the word list, the seed and the
+ * shard, then every game as its position in the list, word, score and
+ * remaining bits
+ */
+bool Simulator::writePartial(const string &path, const vector<Game> &games) const
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) return false;
+
+    put(file, PARTIAL_MAGIC);
+    put(file, PARTIAL_VERSION);
+    put(file, fingerprint(words));
+    put<uint8_t>(file, seeded);
+    put(file, seed);
+    put<uint32_t>(file, words.size());
+    put<uint32_t>(file, shardIndex);
+    put<uint32_t>(file, shardCount);
+    put<uint32_t>(file, targets.size());
+    for (auto &target : targets)
+    {
+        auto &game = games[target];
+        put<uint32_t>(file, target);
+        put<uint8_t>(file, words[target].size());
+        file.write(words[target].data(), words[target].size());
+        put<int32_t>(file, game.score);
+        put<uint32_t>(file, game.remainingBits.size());
+        file.write(reinterpret_cast<const char *>(game.remainingBits.data()),
+                   game.remainingBits.size() * sizeof(double));
+    }
+    file.flush();
+    return bool(file);
+}
+
+/**
+ * @brief Combine the partial results of the shards of a run and report them
+ * as if the run had been made in one process. Games are reported in the
+ * order of the word list, so the points are the same as an unsharded run's
+ *
+ * @param partialPaths one file per shard, in any order
+ * @param pointsPath where the points are written, none if empty
+ * @return false if a file is unreadable, out of range or does not belong to
+ * the same run, shards that are missing only get a warning. The words of the
+ * games are checked against the fingerprint of the list once every shard is
+ * there
+ */
+bool Simulator::merge(const vector<string> &partialPaths, const string &pointsPath)
+{
+    if (partialPaths.empty()) return false;
+    vector<string> words;
+    vector<Game> games;
+    vector<bool> shards;
+    uint64_t runList = 0, runSeed = 0;
+    uint8_t runSeeded = 0;
+    for (auto &path : partialPaths)
+    {
+        ifstream file(path, ios::binary);
+        uint64_t magic, list, seed;
+        uint8_t seeded;
+        uint32_t version, size, index, count, played;
+        if (!get(file, magic) || magic != PARTIAL_MAGIC || !get(file, version) ||
+            version != PARTIAL_VERSION || !get(file, list) || !get(file, seeded) ||
+            !get(file, seed) || !get(file, size) || !get(file, index) ||
+            !get(file, count) || !get(file, played) || size > PARTIAL_MAX_WORDS ||
+            count == 0 || count > size || played > size)
+        {
+            cerr << "Error reading partial results: " << path << endl;
+            return false;
+        }
+        if (shards.empty())
+        {
+            words.resize(size);
+            games.resize(size);
+            shards.resize(count);
+            runList = list, runSeeded = seeded, runSeed = seed;
+        }
+        if (list != runList || seeded != runSeeded || seed != runSeed ||
+            size != words.size() || count != shards.size() || index >= count ||
+            shards[index])
+        {
+            cerr << "Partial results of another run or a shard twice: " << path
+                 << endl;
+            return false;
+        }
+        shards[index] = true;
+
+        int read = 0;
+        for (; read < played; read++)
+        {
+            uint32_t target, bits;
+            uint8_t length;
+            int32_t score;
+            // a shard only plays its own targets
+            if (!get(file, target) || target >= size || target % count != index ||
+                !words[target].empty() || !get(file, length))
+                break;
+            string word(length, ' ');
+            Game game;
+            // a game keeps the remaining bits of each turn but the last
+            if (!file.read(word.data(), length) || !get(file, score) ||
+                !get(file, bits) || bits > Wordle::getMaxGuesses())
+                break;
+            game.score = score;
+            game.remainingBits.resize(bits);
+            if (!file.read(reinterpret_cast<char *>(game.remainingBits.data()),
+                           bits * sizeof(double)))
+                break;
+            words[target] = word;
+            games[target] = move(game);
+        }
+        if (read < played)
+        {
+            cerr << "Truncated or invalid partial results: " << path << endl;
+            return false;
+        }
+    }
+
+    if (count(shards.begin(), shards.end(), false))
+    {
+        cout << "WARN: MISSING SHARDS OF " << shards.size() << ":";
+        for (int i = 0; i < shards.size(); i++)
+            if (!shards[i]) cout << " " << i;
+        cout << endl;
+    }
+    else if (fingerprint(words) != runList)
+    {
+        cerr << "Partial results do not match their word list" << endl;
+        return false;
+    }
+    report(words, games, pointsPath);
+    return true;
+}
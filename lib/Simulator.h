@@ -1,12 +1,58 @@
 #pragma once
 #include "wordle.h"
 
+class ProgressBar;
+
 class Simulator {
    public:
     Simulator(const string &filepath, Wordle &wordle);
     void run(int n);
+    void runTree(int n);
+    void runBatched(int n, int batchSize = 64);
+
+    // play only the targets at positions index, index + count, ... of the
+    // word list, so that count processes together play the whole list
+    void setShard(int index, int count);
+    // where the points are written after a run, none if empty
+    void setPointsPath(const string &path) { pointsPath = path; }
+    // where the games of a run are written for merge, none if empty
+    void setPartialPath(const string &path) { partialPath = path; }
+    // seeds the engine's random targets, the seed goes into the partial
+    // results so that only shards of the same run are merged
+    void setSeed(uint64_t seed);
+    static bool merge(const vector<string> &partialPaths, const string &pointsPath);
 
    private:
+    // the outcome of the game against one target
+    struct Game {
+        // remaining bits before every guess
+        vector<double> remainingBits;
+        // guesses made, 7 if lost, 0 if not played
+        int score = 0;
+    };
+
+    void play(Wordle &game, int target, int n, Game &result) const;
+    void start(Wordle &game, int target, Game &result) const;
+    void turn(Wordle &game, int n, Game &result) const;
+    void expand(int n,
+                vector<string> &history,
+                const vector<int> &targets,
+                vector<Game> &games,
+                ProgressBar &progressBar,
+                int &done);
+    void finish(const vector<Game> &games) const;
+    static void report(const vector<string> &words,
+                       const vector<Game> &games,
+                       const string &pointsPath);
+    bool writePartial(const string &path, const vector<Game> &games) const;
+
     vector<string> words;
+    // positions in words of the targets that are played
+    vector<int> targets;
+    int shardIndex = 0, shardCount = 1;
+    bool seeded = false;
+    uint64_t seed = 0;
+    string pointsPath = "points.txt";
+    string partialPath;
     Wordle &wordle;
-};
\ No newline at end of file
+};
@@ -0,0 +1,168 @@
+#include "batchEvaluator.h"
+#include <algorithm>
+#include <unordered_map>
+#include "parallel.h"
+
+using namespace std;
+
+/**
+ * @brief The games are about to rank the states of a new turn, what the last
+ * turn evaluated is dropped
+ */
+void BatchEvaluator::startTurn()
+{
+    pending.clear();
+    states.clear();
+    evaluated.clear();
+}
+
+/**
+ * @brief Called by a game in place of the engine's evaluation. Guesses the
+ * turn has not evaluated for the state are recorded for the next flush
+ *
+ * @throws Pending if any of the guesses is not evaluated yet
+ */
+vector<Wordle::Word> BatchEvaluator::evaluate(const Wordle::Stat &stat,
+                                              const vector<int> &ids)
+{
+    auto &words = evaluated[stat.key];
+    vector<int> missing;
+    for (int id : ids)
+        if (!words.contains(id)) missing.push_back(id);
+
+    if (!missing.empty())
+    {
+        auto &state = states.try_emplace(stat.key, stat).first->second;
+        auto &request = pending.try_emplace(stat.key).first->second;
+        request.stat = &state;
+        for (int id : missing)
+            if (ranges::find(request.ids, id) == request.ids.end())
+                request.ids.push_back(id);
+        throw Pending();
+    }
+
+    vector<Wordle::Word> result;
+    for (int id : ids) result.push_back(words.at(id));
+    return result;
+}
+
+/**
+ * @brief Evaluate the guesses asked for since the last flush, each one only
+ * for the states that asked for it
+ *
+ * @return false if nothing was asked for
+ */
+bool BatchEvaluator::flush()
+{
+    if (pending.empty()) return false;
+    vector<Request> requests;
+    for (auto &[key, request] : pending) requests.push_back(move(request));
+    pending.clear();
+    evaluate(requests);
+    for (auto &request : requests)
+    {
+        auto &known = evaluated[request.stat->key];
+        for (auto &word : request.words) known[word.id] = word;
+    }
+    passes++;
+    return true;
+}
+
+Wordle::Evaluator BatchEvaluator::getEvaluator()
+{
+    return [this](const Wordle::Stat &stat, const vector<int> &ids) {
+        return evaluate(stat, ids);
+    };
+}
+
+void BatchEvaluator::evaluate(vector<Request> &requests) const
+{
+    const auto &wordIndex = wordle.getWordIndex();
+
+    // the remaining words of all the states are collected into one list, a
+    // state is a list of columns
+    struct State {
+        vector<int> columns;
+        unordered_map<int, Wordle::Word> words;
+    };
+    vector<State> states;
+    vector<int> stateOf(requests.size());
+    unordered_map<string, int> stateIndex;
+    vector<int> column(wordIndex.size(), -1);
+    vector<uint32_t> words;
+    for (int i = 0; i < requests.size(); i++)
+    {
+        auto &stat = *requests[i].stat;
+        auto [it, inserted] = stateIndex.try_emplace(stat.key, states.size());
+        stateOf[i] = it->second;
+        if (!inserted) continue;
+
+        auto &state = states.emplace_back();
+        for (int id : wordle.getCandidateIds(stat))
+        {
+            if (column[id] < 0)
+            {
+                column[id] = words.size();
+                words.push_back(wordIndex.packed(id));
+            }
+            state.columns.push_back(column[id]);
+        }
+    }
+
+    // the states asking for each guess
+    vector<int> guesses;
+    vector<vector<int>> askers;
+    unordered_map<int, int> guessIndex;
+    for (int i = 0; i < requests.size(); i++)
+        for (int id : requests[i].ids)
+        {
+            auto [it, inserted] = guessIndex.try_emplace(id, guesses.size());
+            if (inserted)
+            {
+                guesses.push_back(id);
+                askers.emplace_back();
+            }
+            auto &asking = askers[it->second];
+            if (find(asking.begin(), asking.end(), stateOf[i]) == asking.end())
+                asking.push_back(stateOf[i]);
+        }
+
+    // one pattern row per guess, only the columns of its states are computed.
+    // the guesses are split in blocks that reuse one row
+    const int blockSize = 64;
+    int blocks = (guesses.size() + blockSize - 1) / blockSize;
+    vector<vector<Wordle::Word>> results(guesses.size());
+    parallelFor(blocks, 1ll * guesses.size() * words.size(), [&](int block) {
+        vector<uint8_t> row(words.size());
+        vector<int> computed(words.size(), -1);
+        int end = min<int>(guesses.size(), (block + 1) * blockSize);
+        for (int g = block * blockSize; g < end; g++)
+        {
+            uint32_t guess = wordIndex.packed(guesses[g]);
+            for (int state : askers[g])
+            {
+                int counts[243] = { 0 };
+                for (int c : states[state].columns)
+                {
+                    if (computed[c] != g)
+                    {
+                        computed[c] = g;
+                        row[c] = Wordle::getPatternCode(guess, words[c]);
+                    }
+                    counts[row[c]]++;
+                }
+                results[g].push_back(wordle.getEntropy(guesses[g], counts));
+            }
+        }
+    });
+
+    for (int g = 0; g < guesses.size(); g++)
+        for (int k = 0; k < askers[g].size(); k++)
+            states[askers[g][k]].words[guesses[g]] = results[g][k];
+    for (int i = 0; i < requests.size(); i++)
+    {
+        auto &state = states[stateOf[i]];
+        for (int id : requests[i].ids)
+            requests[i].words.push_back(state.words.at(id));
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "wordle.h"
+
+using namespace std;
+
+/**
+ * @brief Evaluates the guesses of a batch of games in lockstep, on the calling
+ * thread. A game asking for guesses that are not evaluated yet has them
+ * recorded and gives up its ranking with Pending, then the next game ranks.
+ * Once every game of the batch has asked, flush evaluates all the requests in
+ * one pass: the pattern row of a guess is computed once over the remaining
+ * words of the states that asked for it and scattered into their histograms.
+ * The games then rank again and find their guesses evaluated.
+ */
+class BatchEvaluator {
+   public:
+    BatchEvaluator(const Wordle &wordle) : wordle(wordle) {}
+    BatchEvaluator(const BatchEvaluator &) = delete;
+    BatchEvaluator &operator=(const BatchEvaluator &) = delete;
+
+    // thrown by evaluate when the guesses are left for the next flush
+    struct Pending {};
+
+    void startTurn();
+    vector<Wordle::Word> evaluate(const Wordle::Stat &stat, const vector<int> &ids);
+    bool flush();
+    Wordle::Evaluator getEvaluator();
+    // passes made so far, one per flush with requests
+    int getPasses() const { return passes; }
+
+   private:
+    struct Request {
+        const Wordle::Stat *stat;
+        vector<int> ids;
+        vector<Wordle::Word> words;
+    };
+
+    void evaluate(vector<Request> &requests) const;
+
+    const Wordle &wordle;
+    // guesses asked for since the last flush, one request per state key
+    unordered_map<string, Request> pending;
+    // states of the requests, they outlive the games' rankings
+    unordered_map<string, Wordle::Stat> states;
+    // guesses evaluated this turn, by state key and id
+    unordered_map<string, unordered_map<int, Wordle::Word>> evaluated;
+    int passes = 0;
+};
@@ -0,0 +1,180 @@
+#include "cacheLog.h"
+#include <cerrno>
+#include <filesystem>
+#include <random>
+#include <utility>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+// advisory lock on the files of the cache for the length of a scope, shared
+// to append and exclusive to compact. does nothing without a lock file
+class FileLock {
+   public:
+    FileLock(int fd, bool exclusive) : fd(fd)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd == -1) return;
+        while (flock(fd, exclusive ? LOCK_EX : LOCK_SH) == -1 && errno == EINTR)
+            ;
+#endif
+    }
+    ~FileLock()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd != -1) flock(fd, LOCK_UN);
+#endif
+    }
+
+   private:
+    int fd;
+};
+
+// flush a file to the disk, or the entries of a directory
+bool sync(const string &path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#else
+    return true;
+#endif
+}
+}  // namespace
+
+CacheLog::CacheLog(const string &path, Snapshot snapshot, Merge merge)
+    : path(path), snapshot(move(snapshot)), merge(move(merge))
+{
+#if defined(__unix__) || defined(__APPLE__)
+    lockFd = ::open(lockPath(path).c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+    log.open(logPath(path), ios::app);
+    writer = thread(&CacheLog::run, this);
+}
+
+CacheLog::~CacheLog()
+{
+    {
+        lock_guard lock(queueMutex);
+        stopping = true;
+    }
+    ready.notify_one();
+    // the queue is drained before the writer stops
+    writer.join();
+#if defined(__unix__) || defined(__APPLE__)
+    if (lockFd != -1) ::close(lockFd);
+#endif
+}
+
+/**
+ * @brief Queue a record for the log, returns without touching the disk
+ *
+ * @param record one or more complete lines
+ */
+void CacheLog::append(string record)
+{
+    {
+        lock_guard lock(queueMutex);
+        queue.push_back(move(record));
+    }
+    ready.notify_one();
+}
+
+/**
+ * @brief Write a new snapshot and start an empty log. The records the other
+ * engines wrote to the snapshot and the log are merged first, so emptying the
+ * log loses none of them
+ *
+ * @return true if the snapshot was replaced
+ */
+bool CacheLog::compact()
+{
+    lock_guard lock(fileMutex);
+    // no engine appends until the log is emptied
+    FileLock fileLock(lockFd, true);
+    if (merge)
+    {
+        ifstream current(path), appended(logPath(path));
+        merge(current, appended);
+    }
+
+    // unique, in case the lock file could not be opened
+    string tmpPath = path + ".tmp" + to_string(random_device()());
+    int records;
+    {
+        ofstream tmp(tmpPath, ios::out | ios::trunc);
+        if (!tmp.is_open()) return false;
+        records = snapshot(tmp);
+        tmp.flush();
+        if (!tmp) records = -1;
+    }
+    // on the disk before it replaces the old snapshot
+    if (records >= 0 && !sync(tmpPath)) records = -1;
+
+    error_code error;
+    if (records >= 0) filesystem::rename(tmpPath, path, error);
+    if (records < 0 || error)
+    {
+        filesystem::remove(tmpPath, error);
+        return false;
+    }
+    string directory = filesystem::path(path).parent_path().string();
+    sync(directory.empty() ? "." : directory);
+
+    log.close();
+    log.open(logPath(path), ios::out | ios::trunc);
+    logged = 0;
+    // compacting once the log is as large as the snapshot keeps the cost of
+    // persisting proportional to the new records
+    compactAfter = max(1024, records);
+    return true;
+}
+
+/**
+ * @brief Compact on the writer thread, after the records queued before
+ */
+void CacheLog::requestCompaction()
+{
+    {
+        lock_guard lock(queueMutex);
+        compactionRequested = true;
+    }
+    ready.notify_one();
+}
+
+void CacheLog::run()
+{
+    while (true)
+    {
+        vector<string> records;
+        bool requested;
+        {
+            unique_lock lock(queueMutex);
+            ready.wait(lock, [this] {
+                return stopping || !queue.empty() || compactionRequested;
+            });
+            if (queue.empty() && !compactionRequested) return;
+            records.swap(queue);
+            requested = exchange(compactionRequested, false);
+        }
+
+        bool full;
+        {
+            lock_guard lock(fileMutex);
+            FileLock fileLock(lockFd, false);
+            for (auto &record : records) log << record;
+            log.flush();
+            logged += records.size();
+            full = logged >= compactAfter;
+        }
+        if (full || requested) compact();
+    }
+}
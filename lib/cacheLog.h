@@ -0,0 +1,63 @@
+#pragma once
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Persists a cache file without rewriting it on every change. New
+ * records are appended to "<path>.log" by a background thread, and once the
+ * log has grown as large as the snapshot it is compacted into a new snapshot.
+ * Snapshots are written to a temporary file, synced and renamed over the old
+ * one, so a crash leaves either the old or the new snapshot, never a truncated
+ * one. Several engines, in this process or others, may share the files: a
+ * compaction first merges what the others wrote, and holds an advisory lock
+ * on "<path>.lock" so that no record is appended while the log is emptied.
+ */
+class CacheLog {
+   public:
+    // writes the whole cache, returns the number of records or -1 on failure
+    typedef function<int(ostream &)> Snapshot;
+    // reads the current snapshot and log back into the cache
+    typedef function<void(istream &snapshot, istream &log)> Merge;
+
+    CacheLog(const string &path, Snapshot snapshot, Merge merge = {});
+    CacheLog(const CacheLog &) = delete;
+    CacheLog &operator=(const CacheLog &) = delete;
+    ~CacheLog();
+
+    void append(string record);
+    bool compact();
+    void requestCompaction();
+
+    static string logPath(const string &path) { return path + ".log"; }
+    static string lockPath(const string &path) { return path + ".lock"; }
+
+   private:
+    void run();
+
+    string path;
+    Snapshot snapshot;
+    Merge merge;
+    // descriptor of the lock file, -1 if it could not be opened
+    int lockFd = -1;
+
+    mutex queueMutex;
+    condition_variable ready;
+    vector<string> queue;
+    bool stopping = false;
+    bool compactionRequested = false;
+
+    // guards the files, compactions can also be requested by the owner
+    mutex fileMutex;
+    ofstream log;
+    int logged = 0;
+    int compactAfter = 1024;
+
+    thread writer;
+};
@@ -0,0 +1,104 @@
+#include "cacheWarmer.h"
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+#include "ProgressBar.h"
+#include "parallel.h"
+
+using namespace std;
+
+/**
+ * @brief Rank the top n words of the initial state and of every state reached
+ * within depth guesses of the solver's policy. The results end up in the
+ * engine's cache, save it afterwards to keep them. Resets the game
+ *
+ * @param n words ranked per state, lookups for fewer words are cache hits
+ * @param depth guesses made by the policy
+ * @param showProgress
+ * @return number of states ranked
+ */
+int CacheWarmer::run(int n, int depth, bool showProgress)
+{
+    const auto &wordIndex = wordle.getWordIndex();
+    // states are reached by playing against their targets, restored after
+    string targetWord = wordle.getTargetWord();
+    wordle.reset();
+    vector<Wordle::Stat> states = { wordle.getStat(-1) };
+    // guesses leading to each state, replayed to reach its successors
+    vector<vector<string>> histories = { {} };
+    int ranked = 0;
+
+    for (int turn = 0; !states.empty(); turn++)
+    {
+        if (showProgress)
+            cout << "Ranking " << states.size() << " states after " << turn
+                 << " guesses" << endl;
+        auto tops = rank(states, n, showProgress);
+        ranked += states.size();
+        if (turn == depth) break;
+
+        vector<Wordle::Stat> next;
+        vector<vector<string>> nextHistories;
+        unordered_set<string> seen;
+        for (int i = 0; i < states.size(); i++)
+        {
+            if (tops[i].empty()) continue;
+            auto history = histories[i];
+            history.push_back(tops[i][0].word);
+            uint32_t guess = wordIndex.packed(tops[i][0].id);
+
+            // one target per pattern reaches every successor state
+            vector<bool> patterns(243);
+            for (int id : wordle.getCandidateIds(states[i]))
+            {
+                int code = Wordle::getPatternCode(guess, wordIndex.packed(id));
+                if (patterns[code]) continue;
+                patterns[code] = true;
+
+                wordle.reset();
+                wordle.setTargetWord(wordIndex.word(id));
+                for (int j = 0; j + 1 < history.size(); j++)
+                    wordle.guess(history[j]);
+                auto stat = wordle.guess(history.back());
+                if (wordle.isGameOver() || !seen.insert(stat.key).second)
+                    continue;
+                next.push_back(stat);
+                nextHistories.push_back(history);
+            }
+        }
+        states.swap(next);
+        histories.swap(nextHistories);
+    }
+
+    wordle.reset();
+    wordle.setTargetWord(targetWord);
+    return ranked;
+}
+
+/**
+ * @brief Rank the states concurrently, the engine's caches are thread safe.
+ * The rankings share the cores with the states, a state ranked alone gets
+ * all of them
+ */
+vector<vector<Wordle::Word>> CacheWarmer::rank(
+    const vector<Wordle::Stat> &states,
+    int n,
+    bool showProgress) const
+{
+    vector<vector<Wordle::Word>> tops(states.size());
+    ProgressBar progressBar(states.size());
+    mutex progressMutex;
+    int done = 0;
+
+    long long work = 0;
+    for (auto &stat : states)
+        work += 1ll * stat.count * wordle.getWordIndex().size();
+    parallelFor(states.size(), work, [&](int i) {
+        tops[i] = wordle.getTopNWords(n, states[i]);
+        if (!showProgress) return;
+        lock_guard lock(progressMutex);
+        progressBar.update(++done);
+    });
+    if (showProgress) progressBar.finish();
+    return tops;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "wordle.h"
+
+/**
+ * @brief Ranks every state the solver can reach in its first guesses ahead of
+ * time, so that games never wait for a cold early-game state. The solver plays
+ * its best word in each state, so only the patterns of that word are expanded.
+ */
+class CacheWarmer {
+   public:
+    CacheWarmer(Wordle &wordle) : wordle(wordle) {}
+    int run(int n, int depth = 2, bool showProgress = true);
+
+   private:
+    vector<vector<Wordle::Word>> rank(const vector<Wordle::Stat> &states,
+                                      int n,
+                                      bool showProgress) const;
+
+    Wordle &wordle;
+};
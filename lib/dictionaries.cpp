@@ -0,0 +1,107 @@
+#include "dictionaries.h"
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+Dictionaries::Dictionaries(const string &cacheDirectory,
+                           const string &sharedCachePrefix)
+    : cacheDirectory(cacheDirectory), sharedCachePrefix(sharedCachePrefix)
+{}
+
+/**
+ * @brief Register a word list, it is loaded when first used
+ *
+ * @param name
+ * @param allowedFilepath
+ * @param possibleFilepath if empty every allowed word can be the answer
+ * @param cacheFilepath defaults to "entropy_cache_<name>.txt" in the cache
+ * directory
+ */
+void Dictionaries::add(const string &name,
+                       const string &allowedFilepath,
+                       const string &possibleFilepath,
+                       const string &cacheFilepath)
+{
+    lock_guard lock(dictionariesMutex);
+    string cachePath = cacheFilepath;
+    if (cachePath.empty())
+        cachePath = (filesystem::path(cacheDirectory) /
+                     ("entropy_cache_" + name + ".txt"))
+                        .string();
+    dictionaries[name] = {
+        .allowedFilepath = allowedFilepath,
+        .possibleFilepath = possibleFilepath,
+        .cacheFilepath = cachePath,
+    };
+}
+
+bool Dictionaries::contains(const string &name) const
+{
+    lock_guard lock(dictionariesMutex);
+    return dictionaries.contains(name);
+}
+
+vector<string> Dictionaries::getNames() const
+{
+    lock_guard lock(dictionariesMutex);
+    vector<string> names;
+    for (auto &[name, dictionary] : dictionaries) names.push_back(name);
+    return names;
+}
+
+/**
+ * @brief The engine of a word list, loading it on first use
+ *
+ * @return null if there is no such list
+ */
+shared_ptr<const WordleRegression> Dictionaries::get(const string &name)
+{
+    Dictionary dictionary;
+    {
+        lock_guard lock(dictionariesMutex);
+        auto it = dictionaries.find(name);
+        if (it == dictionaries.end()) return nullptr;
+        dictionary = it->second;
+    }
+
+    // the first caller loads it, later callers of the list wait for it
+    auto &loader = *dictionary.loader;
+    call_once(loader.loaded, [&] {
+        auto engine = make_shared<WordleRegression>(
+            dictionary.allowedFilepath, "", dictionary.possibleFilepath,
+            dictionary.cacheFilepath);
+        if (!sharedCachePrefix.empty() &&
+            !engine->openSharedCache(sharedCachePrefix + "_" + name))
+            cout << "WARN: Shared cache unavailable for " << name
+                 << ", using the local cache only" << endl;
+        loader.engine = engine;
+    });
+    return loader.engine;
+}
+
+/**
+ * @brief A new game on a word list with a random target
+ *
+ * @return null if there is no such list
+ */
+shared_ptr<WordleRegression> Dictionaries::newSession(const string &name)
+{
+    auto engine = get(name);
+    if (!engine) return nullptr;
+    auto session = make_shared<WordleRegression>(*engine);
+    {
+        // a copy would repeat the targets of the engine it was copied from
+        lock_guard lock(dictionariesMutex);
+        session->setSeed(random());
+    }
+    session->reset();
+    session->setRandomTargetWord();
+    return session;
+}
+
+void Dictionaries::setSeed(uint64_t seed)
+{
+    lock_guard lock(dictionariesMutex);
+    random.seed(seed);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "wordleRegression.h"
+
+using namespace std;
+
+/**
+ * @brief Word lists served side by side from one process. A list is loaded
+ * the first time it is used, and every session of it is a copy of that engine,
+ * sharing its trie, words and caches. Each list has its own cache file and
+ * shared memory segment, named after the list. Lists share nothing with each
+ * other, so lists that overlap, like 3b1b and wordle, each hold their own
+ * trie of about 68 MiB.
+ */
+class Dictionaries {
+   public:
+    Dictionaries(const string &cacheDirectory = "",
+                 const string &sharedCachePrefix = "");
+
+    void add(const string &name,
+             const string &allowedFilepath,
+             const string &possibleFilepath = "",
+             const string &cacheFilepath = "");
+    bool contains(const string &name) const;
+    vector<string> getNames() const;
+    shared_ptr<const WordleRegression> get(const string &name);
+    shared_ptr<WordleRegression> newSession(const string &name);
+    // sessions draw their targets from one generator, seeded from the system
+    void setSeed(uint64_t seed);
+
+   private:
+    // loads a list once, outside the registry lock, so that other lists
+    // stay available while it loads
+    struct Loader {
+        once_flag loaded;
+        shared_ptr<const WordleRegression> engine;
+    };
+    struct Dictionary {
+        string allowedFilepath;
+        string possibleFilepath;
+        string cacheFilepath;
+        shared_ptr<Loader> loader = make_shared<Loader>();
+    };
+
+    string cacheDirectory;
+    // segments are named prefix + "_" + name, none if empty
+    string sharedCachePrefix;
+    map<string, Dictionary> dictionaries;
+    mt19937_64 random{ random_device()() };
+    mutable mutex dictionariesMutex;
+};
@@ -0,0 +1,207 @@
+#include "engineHarness.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+
+using namespace std;
+
+const int nameWidth = 18, numWidth = 14;
+
+void EngineHarness::add(const string &name, Wordle &engine)
+{
+    names.push_back(name);
+    engines.push_back(&engine);
+    throughput.push_back({ .engine = name });
+}
+
+/**
+ * @brief Play the guesses against every possible answer, until the game is
+ * over
+ *
+ * @param guesses the same for every target
+ * @param probes random guesses whose histograms are compared in every state
+ * @param seed of the probes
+ * @return number of mismatches found
+ */
+int EngineHarness::runExhaustive(const vector<string> &guesses,
+                                 int probes,
+                                 uint64_t seed)
+{
+    if (engines.empty()) return 0;
+    auto &reference = *engines[0];
+    auto &index = reference.getWordIndex();
+    mt19937_64 random(seed);
+    uniform_int_distribution<int> word(0, index.size() - 1);
+
+    reference.reset();
+    int found = 0;
+    for (int target : reference.getCandidateIds(reference.getStat(0)))
+    {
+        vector<string> probeWords;
+        for (int i = 0; i < probes; i++)
+            probeWords.push_back(index.word(word(random)));
+        found += play(index.word(target), guesses, probeWords);
+    }
+    return found;
+}
+
+/**
+ * @brief Play random guesses against random answers
+ *
+ * @param games
+ * @param probes random guesses whose histograms are compared in every state
+ * @param seed the games are the same for the same seed
+ * @return number of mismatches found
+ */
+int EngineHarness::runRandom(int games, int probes, uint64_t seed)
+{
+    if (engines.empty()) return 0;
+    auto &reference = *engines[0];
+    auto &index = reference.getWordIndex();
+    mt19937_64 random(seed);
+    uniform_int_distribution<int> word(0, index.size() - 1);
+
+    reference.reset();
+    vector<int> targets;
+    for (int id : reference.getCandidateIds(reference.getStat(0)))
+        targets.push_back(id);
+    uniform_int_distribution<int> target(0, targets.size() - 1);
+
+    int found = 0;
+    for (int i = 0; i < games; i++)
+    {
+        string targetWord = index.word(targets[target(random)]);
+        vector<string> guesses, probeWords;
+        for (int j = 0; j < reference.getMaxGuesses(); j++)
+            guesses.push_back(index.word(word(random)));
+        for (int j = 0; j < probes; j++)
+            probeWords.push_back(index.word(word(random)));
+        found += play(targetWord, guesses, probeWords);
+    }
+    return found;
+}
+
+/**
+ * @brief Play one game on every engine. Histograms are compared in the new
+ * state and in the state before it, an engine must not assume that it is only
+ * asked about its latest state
+ */
+int EngineHarness::play(const string &target,
+                        const vector<string> &guesses,
+                        const vector<string> &probes)
+{
+    using Clock = chrono::steady_clock;
+    auto seconds = [](Clock::time_point start) {
+        return chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    int before = mismatchCount;
+    for (auto &engine : engines)
+    {
+        engine->reset();
+        engine->setTargetWord(target);
+    }
+
+    vector<string> history = { target };
+    for (auto &guess : guesses)
+    {
+        if (engines[0]->isGameOver()) break;
+        history.push_back(guess);
+
+        vector<Wordle::Stat> stats;
+        for (int e = 0; e < engines.size(); e++)
+        {
+            auto start = Clock::now();
+            stats.push_back(engines[e]->guess(guess));
+            throughput[e].guessSeconds += seconds(start);
+            throughput[e].states++;
+        }
+
+        auto &expected = stats[0];
+        for (int e = 1; e < engines.size(); e++)
+        {
+            auto &stat = stats[e];
+            if (stat.pattern != expected.pattern)
+                mismatch(e, history,
+                         "pattern " + stat.pattern + " instead of " +
+                             expected.pattern);
+            if (stat.count != expected.count)
+                mismatch(e, history,
+                         "count " + to_string(stat.count) + " instead of " +
+                             to_string(expected.count));
+            if (stat.key != expected.key)
+                mismatch(e, history, "different remaining words");
+            if (!feq(stat.entropy, expected.entropy))
+                mismatch(e, history,
+                         "entropy " + to_string(stat.entropy) + " instead of " +
+                             to_string(expected.entropy));
+            if (engines[e]->getStatus() != engines[0]->getStatus())
+                mismatch(e, history, "different game status");
+        }
+
+        for (int back : { 0, 1 })
+        {
+            for (auto &probe : probes)
+            {
+                map<string, int> reference;
+                for (int e = 0; e < engines.size(); e++)
+                {
+                    auto &engine = *engines[e];
+                    auto stat = engine.getStat(engine.getGuesses() - back);
+                    auto start = Clock::now();
+                    auto counts =
+                        engine.getPatternsCounts(probe, stat.query, stat.live.get());
+                    throughput[e].histogramSeconds += seconds(start);
+                    throughput[e].histograms++;
+
+                    map<string, int> histogram(counts.begin(), counts.end());
+                    if (e == 0) reference.swap(histogram);
+                    else if (histogram != reference)
+                        mismatch(e, history,
+                                 "histogram of " + probe +
+                                     (back ? " in the previous state" : ""));
+                }
+            }
+        }
+    }
+    return mismatchCount - before;
+}
+
+void EngineHarness::mismatch(int engine,
+                             const vector<string> &history,
+                             const string &detail)
+{
+    if (mismatchCount++ < maxMismatches)
+        mismatches.push_back({
+            .engine = names[engine],
+            .history = history,
+            .detail = detail,
+        });
+}
+
+void EngineHarness::printReport() const
+{
+    cout << left << setw(nameWidth) << "ENGINE" << right << setw(numWidth)
+         << "STATES" << setw(numWidth) << "STATES/S" << setw(numWidth)
+         << "HISTOGRAMS" << setw(numWidth) << "HISTOGRAMS/S" << endl;
+    for (auto &engine : throughput)
+        cout << left << setw(nameWidth) << engine.engine << right << fixed
+             << setprecision(0) << setw(numWidth) << engine.states
+             << setw(numWidth) << engine.states / max(engine.guessSeconds, 1e-9)
+             << setw(numWidth) << engine.histograms << setw(numWidth)
+             << engine.histograms / max(engine.histogramSeconds, 1e-9) << endl;
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+    cout << mismatchCount << " mismatches" << endl;
+    for (auto &mismatch : mismatches)
+    {
+        cout << "  " << mismatch.engine << ", target " << mismatch.history[0]
+             << ", guesses";
+        for (int i = 1; i < mismatch.history.size(); i++)
+            cout << " " << mismatch.history[i];
+        cout << ": " << mismatch.detail << endl;
+    }
+}
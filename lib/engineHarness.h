@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "wordle.h"
+
+using namespace std;
+
+/**
+ * @brief Plays the same games through several engines on the same word lists
+ * and checks that they agree on every state: the pattern, the number of
+ * remaining words, the entropy of the guess and the pattern histograms of a
+ * few probe guesses. The first engine is the reference. The time each engine
+ * spends is kept, so their throughput can be compared side by side.
+ */
+class EngineHarness {
+   public:
+    struct Mismatch {
+        string engine;
+        // guesses that led to the state, the target first
+        vector<string> history;
+        string detail;
+    };
+
+    // work done and time spent by one engine
+    struct Throughput {
+        string engine;
+        long long states = 0;
+        long long histograms = 0;
+        double guessSeconds = 0;
+        double histogramSeconds = 0;
+    };
+
+    void add(const string &name, Wordle &engine);
+    int runExhaustive(const vector<string> &guesses,
+                      int probes = 8,
+                      uint64_t seed = 1);
+    int runRandom(int games, int probes = 8, uint64_t seed = 1);
+    void printReport() const;
+
+    const vector<Mismatch> &getMismatches() const { return mismatches; }
+    const vector<Throughput> &getThroughput() const { return throughput; }
+
+   private:
+    // the most mismatches kept, later ones are only counted
+    static const int maxMismatches = 20;
+
+    int play(const string &target,
+             const vector<string> &guesses,
+             const vector<string> &probes);
+    void mismatch(int engine, const vector<string> &history, const string &detail);
+
+    vector<string> names;
+    vector<Wordle *> engines;
+    vector<Throughput> throughput;
+    vector<Mismatch> mismatches;
+    int mismatchCount = 0;
+};
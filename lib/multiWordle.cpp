@@ -0,0 +1,271 @@
+#include "multiWordle.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <set>
+
+using namespace std;
+
+const int titleWidth = 23, numWidth = 5;
+
+MultiWordle::MultiWordle(Wordle &wordle, int boards)
+    : wordle(wordle), boards(boards)
+{
+    setRandomTargetWords();
+}
+
+MultiWordle::MultiWordle(Wordle &wordle, const vector<string> &targetWords)
+    : wordle(wordle)
+{
+    setTargetWords(targetWords);
+}
+
+/**
+ * @brief Apply the guess to every unsolved board
+ *
+ * @param guess
+ * @return vector<string> pattern of each board, empty for boards solved before
+ */
+vector<string> MultiWordle::guess(const string &guess)
+{
+    auto lock = wordle.lockWords();
+    if (isGameOver() || !wordle.isWordValid(guess)) return {};
+
+    guesses++;
+    auto &index = wordle.getWordIndex();
+    uint32_t packed = WordIndex<N>::pack(guess);
+    vector<string> patterns(boards.size());
+    for (int i = 0; i < boards.size(); i++)
+    {
+        auto &board = boards[i];
+        if (board.solved) continue;
+        int code = Wordle::getPatternCode(packed, WordIndex<N>::pack(board.targetWord));
+        erase_if(board.candidates, [&](int id) {
+            return Wordle::getPatternCode(packed, index.packed(id)) != code;
+        });
+        board.patterns.push_back(Wordle::getPattern(code));
+        board.solved = guess == board.targetWord;
+        patterns[i] = board.patterns.back();
+    }
+    updateColumns();
+
+    if (all_of(boards.begin(), boards.end(),
+               [](const Board &board) { return board.solved; }))
+        status = Wordle::GameStatus::WON;
+    else if (guesses == getMaxGuesses()) status = Wordle::GameStatus::LOST;
+
+    return patterns;
+}
+
+/**
+ * @brief pattern of the guess against every remaining word
+ */
+vector<uint8_t> MultiWordle::getPatternRow(uint32_t guess) const
+{
+    vector<uint8_t> row(words.size());
+    for (int i = 0; i < words.size(); i++)
+        row[i] = Wordle::getPatternCode(guess, words[i]);
+    return row;
+}
+
+Wordle::Word MultiWordle::getEntropy(const string &guess) const
+{
+    auto lock = wordle.lockWords();
+    uint32_t packed = WordIndex<N>::pack(guess);
+    return getEntropy(packed, getPatternRow(packed));
+}
+
+/**
+ * @brief entropies of the boards add up since the targets are independent,
+ * so the score is the joint entropy of the patterns of all unsolved boards
+ */
+Wordle::Word MultiWordle::getEntropy(uint32_t guess,
+                                     const vector<uint8_t> &row) const
+{
+    double entropy = 0, maxEntropy = 0;
+    int maxBucket = 0;
+    for (auto &group : groups)
+    {
+        int counts[243] = { 0 }, patterns = 0;
+        for (auto &column : group.columns)
+            if (!counts[row[column]]++) patterns++;
+
+        double total = group.columns.size(), groupEntropy = 0;
+        for (auto &count : counts)
+        {
+            if (!count) continue;
+            groupEntropy += count / total * (log2(total) - log2(count));
+            maxBucket = max(maxBucket, count);
+        }
+        entropy += group.boards * groupEntropy;
+        maxEntropy += group.boards * log2(patterns);
+    }
+
+    return {
+        .word = WordIndex<N>::unpack(guess),
+        .score = entropy,
+        .entropy = entropy,
+        .maxEntropy = maxEntropy,
+        .maxBucket = maxBucket,
+        .id = wordle.getWordIndex().id(guess),
+    };
+}
+
+/**
+ * @brief Rank the best n guesses over all unsolved boards. A guess that can
+ * be the answer on more boards is preferred between equal scores
+ */
+vector<Wordle::Word> MultiWordle::getTopNWords(const int n) const
+{
+    using Word = Wordle::Word;
+    if (n == 0 || isGameOver()) return {};
+    auto lock = wordle.lockWords();
+
+    // chance of solving a board with the guess, by word id
+    unordered_map<int, double> solves;
+    for (auto &board : boards)
+        if (!board.solved)
+            for (auto &id : board.candidates)
+                solves[id] += 1.0 / board.candidates.size();
+    auto solveChance = [&solves](const Word &word) {
+        auto it = solves.find(word.id);
+        return it == solves.end() ? 0 : it->second;
+    };
+
+    // compared on a grid, feq is not transitive
+    auto comp = [&](const Word &a, const Word &b) {
+        if (scoreKey(a.score) != scoreKey(b.score))
+            return scoreKey(a.score) > scoreKey(b.score);
+        if (scoreKey(solveChance(a)) != scoreKey(solveChance(b)))
+            return scoreKey(solveChance(a)) > scoreKey(solveChance(b));
+        return a.word < b.word;
+    };
+    set<Word, decltype(comp)> topWords(comp);
+
+    // a board can give at most the initial max entropy of the guess, and at
+    // most log2 of its remaining words. the ranking is sorted by the former so
+    // the bound only decreases
+    auto bound = [this](const Word &ranked) {
+        double bits = 0;
+        for (auto &group : groups)
+            bits += group.boards *
+                    min(log2(group.columns.size()), ranked.maxEntropy);
+        return bits;
+    };
+
+    // before the first guess every board is in the initial state, which the
+    // ranking has already evaluated
+    bool initial = guesses == 0 && groups.size() == 1;
+    for (auto &ranked : *wordle.getRanking())
+    {
+        // [equal because we need to rank words that can be the answer higher]
+        if (topWords.size() == n && bound(ranked) < prev(topWords.end())->entropy)
+            break;
+
+        uint32_t guess = wordle.getWordIndex().packed(ranked.id);
+        auto word = initial ? ranked : getEntropy(guess, getPatternRow(guess));
+        if (initial)
+        {
+            word.entropy *= groups[0].boards;
+            word.maxEntropy *= groups[0].boards;
+            word.score = word.entropy;
+        }
+        if (feq(word.maxEntropy, 0) && !solveChance(word)) continue;
+
+        topWords.insert(word);
+        if (topWords.size() > n) topWords.erase(prev(topWords.end()));
+    }
+
+    return vector<Word>(topWords.begin(), topWords.end());
+}
+
+/**
+ * @brief recollect the remaining words of the unsolved boards, words shared
+ * by several boards get one column and boards with the same words one group
+ */
+void MultiWordle::updateColumns()
+{
+    auto &index = wordle.getWordIndex();
+    vector<int> ids;
+    for (auto &board : boards)
+        if (!board.solved)
+            ids.insert(ids.end(), board.candidates.begin(), board.candidates.end());
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    words.clear();
+    for (auto &id : ids) words.push_back(index.packed(id));
+
+    groups.clear();
+    for (auto &board : boards)
+    {
+        if (board.solved) continue;
+        vector<int> columns;
+        for (auto &id : board.candidates)
+            columns.push_back(lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+
+        auto it = find_if(groups.begin(), groups.end(), [&](const Group &group) {
+            return group.columns == columns;
+        });
+        if (it != groups.end()) it->boards++;
+        else groups.push_back({ .columns = columns, .boards = 1 });
+    }
+}
+
+void MultiWordle::printBoards() const
+{
+    for (int i = 0; i < boards.size(); i++)
+    {
+        auto &board = boards[i];
+        string title = "BOARD " + to_string(i + 1) + ": ";
+        cout << setw(titleWidth) << title;
+        for (auto &pattern : board.patterns)
+            cout << Wordle::guess2emoji(pattern) << " ";
+        if (board.solved) cout << "SOLVED";
+        else cout << "(" << board.candidates.size() << " left)";
+        cout << endl;
+    }
+}
+
+void MultiWordle::printTopNWords(int n) const
+{
+    cout << "Calculating top " << n << " words..." << endl;
+    string title = "TOP " + to_string(n) + " WORDS: ";
+    cout << setw(titleWidth) << title << "WORDS | SCORE" << endl;
+    for (auto &word : getTopNWords(n))
+        cout << setw(titleWidth) << "" << word.word << " | " << setw(numWidth)
+             << fixed << setprecision(2) << word.score << endl;
+}
+
+void MultiWordle::reset()
+{
+    auto lock = wordle.lockWords();
+    guesses = 0;
+    status = Wordle::GameStatus::ONGOING;
+    auto root = wordle.getStat(0).candidates;
+    for (auto &board : boards)
+    {
+        board.candidates.clear();
+        for (int id = 0; id < root->size(); id++)
+            if ((*root)[id]) board.candidates.push_back(id);
+        board.patterns.clear();
+        board.solved = false;
+    }
+    updateColumns();
+}
+
+void MultiWordle::setTargetWords(const vector<string> &targetWords)
+{
+    boards.assign(targetWords.size(), {});
+    for (int i = 0; i < boards.size(); i++)
+        boards[i].targetWord = targetWords[i];
+    reset();
+}
+
+void MultiWordle::setRandomTargetWords()
+{
+    vector<string> targetWords;
+    for (int i = 0; i < boards.size(); i++)
+        targetWords.push_back(wordle.getRandomWord());
+    setTargetWords(targetWords);
+}
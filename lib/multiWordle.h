@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "wordle.h"
+
+using namespace std;
+
+/**
+ * @brief Plays one guess on several boards at once (Quordle, Octordle).
+ * The word lists and the initial ranking are shared with a single board
+ * engine, each board only keeps its target and remaining words. Random targets
+ * are drawn from the engine's generator, so its seed makes them reproducible.
+ */
+class MultiWordle {
+   public:
+    struct Board {
+        string targetWord;
+        // ids of the remaining words
+        vector<int> candidates;
+        vector<string> patterns;
+        bool solved = false;
+    };
+
+    MultiWordle(Wordle &wordle, int boards);
+    MultiWordle(Wordle &wordle, const vector<string> &targetWords);
+
+    // Methods
+    vector<string> guess(const string &guess);
+    bool isGameOver() const { return status != Wordle::GameStatus::ONGOING; }
+    void printBoards() const;
+    void printTopNWords(int n) const;
+    void reset();
+
+    // Getters
+    int getGuesses() const { return guesses; }
+    int getMaxGuesses() const { return boards.size() + 5; }
+    Wordle::GameStatus getStatus() const { return status; }
+    const Board &getBoard(int i) const { return boards[i]; }
+    int getBoardCount() const { return boards.size(); }
+    Wordle::Word getEntropy(const string &guess) const;
+    vector<Wordle::Word> getTopNWords(const int n) const;
+
+    // Setters
+    void setTargetWords(const vector<string> &targetWords);
+    void setRandomTargetWords();
+
+   private:
+    static const size_t N = 5;
+
+    vector<uint8_t> getPatternRow(uint32_t guess) const;
+    Wordle::Word getEntropy(uint32_t guess, const vector<uint8_t> &row) const;
+    void updateColumns();
+
+    Wordle &wordle;
+    int guesses = 0;
+    Wordle::GameStatus status = Wordle::GameStatus::ONGOING;
+    vector<Board> boards;
+    // boards with the same remaining words, counted once per guess
+    struct Group {
+        // position in words of the remaining words
+        vector<int> columns;
+        int boards;
+    };
+
+    // remaining words of all unsolved boards, a pattern row has one entry
+    // per word so it is computed once and shared by the boards
+    vector<uint32_t> words;
+    vector<Group> groups;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// threads a parallelFor called on this thread may use. the threads of a
+// parallelFor split the budget of its caller, so that a parallelFor nested in
+// another one does not start a pool on every thread of the outer one
+inline thread_local int threadBudget = max(1u, thread::hardware_concurrency());
+
+// calls f(i) for every i below size, on up to one thread per core. work is
+// the number of patterns computed, not worth starting threads for a handful
+template <typename F>
+void parallelFor(int size, long long work, F &&f)
+{
+    int threads = max(1ll, min<long long>({ threadBudget, work / (1 << 14), size }));
+    int budget = max(threadBudget / threads, 1);
+    atomic<int> next = 0;
+    auto run = [&] {
+        int outer = exchange(threadBudget, budget);
+        for (int i; (i = next++) < size;) f(i);
+        threadBudget = outer;
+    };
+    vector<thread> workers;
+    for (int i = 1; i < threads; i++) workers.emplace_back(run);
+    run();
+    for (auto &worker : workers) worker.join();
+}
@@ -0,0 +1,80 @@
+#include "precomputer.h"
+#include <algorithm>
+
+using namespace std;
+
+Precomputer::Precomputer(const Wordle &wordle, int n, int buckets, int threads)
+    : wordle(wordle), n(n), buckets(buckets), threads(threads)
+{}
+
+/**
+ * @brief Start ranking the states the guess can lead to from the current
+ * state of the game. Stops what was started before
+ *
+ * @param guess usually the best suggestion
+ */
+void Precomputer::start(const string &guess)
+{
+    stop();
+    targets.clear();
+    next = 0, ranked = 0;
+    if (wordle.isGameOver() || !wordle.isWordValid(guess)) return;
+
+    auto &index = wordle.getWordIndex();
+    auto stat = wordle.getStat(-1);
+    uint32_t packed = index.packed(index.id(guess));
+    // the chance of a pattern is the share of remaining words in its bucket
+    int counts[243] = { 0 }, first[243];
+    for (int id : wordle.getCandidateIds(stat))
+    {
+        int code = Wordle::getPatternCode(packed, index.packed(id));
+        if (!counts[code]++) first[code] = id;
+    }
+    vector<int> codes;
+    const int allCorrect = 242;
+    for (int code = 0; code < allCorrect; code++)
+        if (counts[code]) codes.push_back(code);
+    stable_sort(codes.begin(), codes.end(),
+                [&](int a, int b) { return counts[a] > counts[b]; });
+    // the adversary picks the pattern whatever the target, there is one state
+    int states = wordle.getGameMode() == Wordle::GameMode::ADVERSARIAL ? 1 : buckets;
+    if (codes.size() > states) codes.resize(states);
+
+    for (int code : codes) targets.push_back(index.word(first[code]));
+    game = wordle.clone();
+    this->guess = guess;
+    for (int i = 0; i < min<int>(threads, targets.size()); i++)
+        workers.emplace_back([this](stop_token stop) { run(stop); });
+}
+
+/**
+ * @brief Cancel the rankings in progress, the entropies they computed are
+ * kept so a ranking of the same state later starts from them
+ */
+void Precomputer::stop()
+{
+    for (auto &worker : workers) worker.request_stop();
+    wait();
+}
+
+void Precomputer::wait()
+{
+    for (auto &worker : workers) worker.join();
+    workers.clear();
+}
+
+void Precomputer::run(stop_token stop)
+{
+    for (int i; !stop.stop_requested() && (i = next++) < targets.size();)
+    {
+        auto copy = game->clone();
+        copy->setTargetWord(targets[i]);
+        auto stat = copy->guess(guess);
+        if (copy->isGameOver()) continue;
+
+        bool exact;
+        copy->getTopNWords(n, stat, chrono::steady_clock::time_point::max(), stop,
+                           exact);
+        if (exact) ranked++;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wordle.h"
+
+using namespace std;
+
+/**
+ * @brief Ranks the states a guess is likely to lead to while the player is
+ * still deciding, so that the next ranking is a cache hit. The patterns of the
+ * guess are ranked most likely first on background threads, each on its own
+ * copy of the engine, which shares the caches with the original.
+ */
+class Precomputer {
+   public:
+    Precomputer(const Wordle &wordle, int n, int buckets = 8, int threads = 1);
+    Precomputer(const Precomputer &) = delete;
+    Precomputer &operator=(const Precomputer &) = delete;
+    ~Precomputer() { stop(); }
+
+    void start(const string &guess);
+    void stop();
+    void wait();
+    // states ranked completely since the last start
+    int getRanked() const { return ranked; }
+
+   private:
+    void run(stop_token stop);
+
+    const Wordle &wordle;
+    // words ranked per state, patterns ranked per guess
+    int n, buckets, threads;
+
+    // the game when start was called, every state is reached from a copy
+    shared_ptr<const Wordle> game;
+    string guess;
+    // one target per pattern, most likely pattern first
+    vector<string> targets;
+    atomic<int> next = 0, ranked = 0;
+    vector<jthread> workers;
+};
@@ -0,0 +1,202 @@
+#include "sharedCache.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+const uint64_t MAGIC = 0x57524c4443414348ull;  // "WRLDCACH"
+const uint64_t VERSION = 2;
+// slots probed before a key is considered missing
+const int MAX_PROBES = 32;
+}  // namespace
+
+SharedCache::~SharedCache()
+{
+    close();
+}
+
+/**
+ * @brief Detach from the segment, finds miss and stores are dropped after
+ */
+void SharedCache::close()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (header) munmap(header, size);
+#endif
+    header = nullptr, slots = nullptr, size = 0;
+}
+
+/**
+ * @brief Attach to the named segment, creating it if it does not exist.
+ * Fails if the segment was made for other word lists or another layout
+ *
+ * @param name shm name, eg. "/wordle_cache"
+ * @param fingerprint of the word lists
+ * @param capacity number of slots, rounded up to a power of 2
+ * @return true if the cache can be used
+ */
+bool SharedCache::open(const string &name, uint64_t fingerprint, size_t capacity)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (header) return false;
+    size_t slotCount = 1;
+    while (slotCount < capacity) slotCount <<= 1;
+    size_t bytes = sizeof(Header) + slotCount * sizeof(Slot);
+
+    bool created = true;
+    // only processes of the same user may read or write the results
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+    {
+        created = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd == -1) return false;
+
+    if (created && ftruncate(fd, bytes) == -1)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // the creator might not have sized the segment yet
+    struct stat info;
+    for (int i = 0; i < 100 && fstat(fd, &info) == 0 && info.st_size == 0; i++)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    if (fstat(fd, &info) == -1 || info.st_size < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    bytes = info.st_size;
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    auto *segment = static_cast<Header *>(memory);
+    if (created)
+    {
+        // a fresh segment is zero filled, so every slot is already empty
+        segment->version = VERSION;
+        segment->fingerprint = fingerprint;
+        segment->capacity = slotCount;
+        segment->magic.store(MAGIC, memory_order_release);
+    }
+    else
+    {
+        for (int i = 0; i < 100 && segment->magic.load(memory_order_acquire) != MAGIC;
+             i++)
+            this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (segment->magic.load(memory_order_acquire) != MAGIC ||
+        segment->version != VERSION || segment->fingerprint != fingerprint ||
+        sizeof(Header) + segment->capacity * sizeof(Slot) > bytes)
+    {
+        munmap(memory, bytes);
+        return false;
+    }
+
+    header = segment;
+    slots = reinterpret_cast<Slot *>(segment + 1);
+    size = bytes;
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t SharedCache::hash(const string &key)
+{
+    // FNV-1a, 0 marks an empty slot
+    uint64_t hash = 14695981039346656037ull;
+    for (auto &c : key) hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Look up the top words of a state
+ *
+ * @param key state key
+ * @param n number of words that was asked for when the entry was stored
+ * @param words ids are not checked against the word lists
+ * @return true if there was a complete entry
+ */
+bool SharedCache::find(const string &key, int &n, vector<Record> &words) const
+{
+    if (!header) return false;
+    uint64_t h = hash(key), mask = header->capacity - 1;
+    for (uint64_t i = 0, s = h & mask; i < MAX_PROBES; i++, s = (s + 1) & mask)
+    {
+        Slot &slot = slots[s];
+        uint64_t slotKey = slot.key.load(memory_order_acquire);
+        if (slotKey == 0) return false;
+        if (slotKey != h) continue;
+
+        uint32_t before = slot.seq.load(memory_order_acquire);
+        if (before == 0 || before & 1) return false;
+        // another state with the same hash is a miss
+        if (slot.keyLength != key.size() ||
+            memcmp(slot.keyText, key.data(), key.size()))
+            return false;
+        int count = slot.count;
+        n = slot.n;
+        // a corrupt slot is a miss
+        if (count < 0 || count > maxWords) return false;
+        words.assign(slot.words, slot.words + count);
+        // the copy only counts if no writer touched the slot meanwhile
+        atomic_thread_fence(memory_order_acquire);
+        return slot.seq.load(memory_order_relaxed) == before;
+    }
+    return false;
+}
+
+/**
+ * @brief Publish the top words of a state. Gives up instead of waiting when
+ * another process is writing the same slot
+ *
+ * @return true if the entry was written, keys over maxKeyLength are not
+ */
+bool SharedCache::store(const string &key, int n, const vector<Record> &words)
+{
+    if (!header || words.size() > maxWords || key.size() > maxKeyLength)
+        return false;
+    uint64_t h = hash(key), mask = header->capacity - 1;
+    for (uint64_t i = 0, s = h & mask; i < MAX_PROBES; i++, s = (s + 1) & mask)
+    {
+        Slot &slot = slots[s];
+        uint64_t slotKey = slot.key.load(memory_order_acquire);
+        // claim an empty slot, if another process got there first slotKey
+        // holds their key
+        if (slotKey == 0 &&
+            slot.key.compare_exchange_strong(slotKey, h, memory_order_acq_rel))
+            slotKey = h;
+        if (slotKey != h) continue;
+
+        uint32_t seq = slot.seq.load(memory_order_acquire);
+        if (seq & 1 ||
+            !slot.seq.compare_exchange_strong(seq, seq + 1, memory_order_acquire))
+            return false;
+        // the slot must read as odd before any of the new data does
+        atomic_thread_fence(memory_order_release);
+        // a state with the same hash is replaced
+        slot.keyLength = key.size();
+        memcpy(slot.keyText, key.data(), key.size());
+        slot.n = n;
+        slot.count = words.size();
+        memcpy(slot.words, words.data(), words.size() * sizeof(Record));
+        slot.seq.store(seq + 2, memory_order_release);
+        return true;
+    }
+    return false;
+}
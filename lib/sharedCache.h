@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Top words of solved states in a shared memory segment, so that every
+ * solver process on the machine can read and add results. The table uses
+ * open addressing without locks, every slot is guarded by a sequence number
+ * that is odd while the slot is written. Entries are never removed, when the
+ * table is full new results are dropped.
+ */
+class SharedCache {
+   public:
+    struct Record {
+        int32_t id;
+        int32_t maxBucket;
+        double score;
+        double entropy;
+        double maxEntropy;
+    };
+
+    // the most words stored per state
+    static constexpr int maxWords = 16;
+    // the longest state key stored, a state key with a suffix fits
+    static constexpr int maxKeyLength = 32;
+
+    SharedCache() = default;
+    SharedCache(const SharedCache &) = delete;
+    SharedCache &operator=(const SharedCache &) = delete;
+    ~SharedCache();
+
+    bool open(const string &name, uint64_t fingerprint, size_t capacity);
+    void close();
+    bool find(const string &key, int &n, vector<Record> &words) const;
+    bool store(const string &key, int n, const vector<Record> &words);
+    bool isOpen() const { return header != nullptr; }
+    // mapped bytes and slots
+    size_t getSize() const { return size; }
+    size_t getCapacity() const { return header ? header->capacity : 0; }
+
+   private:
+    struct Slot {
+        // hash of the state key, 0 if the slot is empty
+        atomic<uint64_t> key;
+        // odd while the slot is written, 0 before the first write
+        atomic<uint32_t> seq;
+        // the whole state key, two keys can share a hash
+        int32_t keyLength;
+        char keyText[maxKeyLength];
+        int32_t n;
+        int32_t count;
+        Record words[maxWords];
+    };
+
+    struct Header {
+        atomic<uint64_t> magic;
+        uint64_t version;
+        // identifies the word lists the ids refer to
+        uint64_t fingerprint;
+        uint64_t capacity;
+    };
+
+    static_assert(atomic<uint64_t>::is_always_lock_free &&
+                      atomic<uint32_t>::is_always_lock_free,
+                  "atomics must be lock free to be shared between processes");
+
+    static uint64_t hash(const string &key);
+
+    Header *header = nullptr;
+    Slot *slots = nullptr;
+    size_t size = 0;
+};
@@ -1,20 +1,66 @@
 #include "trie.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include "parallel.h"
 
 using namespace std;
 
 template <size_t N>
 Trie<N>::Trie()
 {
-    root = new Node();
+    root = new Node(nodes++);
 }
 
 template <size_t N>
-Trie<N>::Node::Node()
-    : children(), count(), letterCntAtPos(), WordCountWithLetter(), isEnd(false)
+Trie<N>::Node::Node(int id)
+    : children(),
+      count(),
+      letterCntAtPos(),
+      WordCountWithLetter(),
+      letterOccuredAtleast(),
+      presentAtPos(),
+      everyAtPos(),
+      onlyAtPos(),
+      inEvery(),
+      atleast(),
+      isEnd(false),
+      id(id)
 {}
 
+/**
+ * @brief Rebuild the letter masks from the counts
+ *
+ * @tparam N
+ * @param id
+ */
+template <size_t N>
+void Trie<N>::Node::summarize(const ID &id)
+{
+    for (int i = 0; i < N; i++)
+    {
+        presentAtPos[id][i] = everyAtPos[id][i] = onlyAtPos[id][i] = 0;
+        for (int c = 0; c < 26; c++)
+        {
+            int words = letterCntAtPos[id][i][c];
+            if (words) presentAtPos[id][i] |= 1u << c;
+            if (words == count[id]) everyAtPos[id][i] |= 1u << c;
+            if (words == WordCountWithLetter[id][c]) onlyAtPos[id][i] |= 1u << c;
+        }
+    }
+
+    inEvery[id] = 0;
+    for (int c = 0; c < 26; c++)
+        if (WordCountWithLetter[id][c] == count[id]) inEvery[id] |= 1u << c;
+
+    for (int k = 0; k <= N; k++)
+    {
+        atleast[id][k] = 0;
+        for (int c = 0; c < 26; c++)
+            if (letterOccuredAtleast[id][c][k]) atleast[id][k] |= 1u << c;
+    }
+}
+
 template <size_t N>
 Trie<N>::~Trie()
 {
@@ -46,33 +92,235 @@ template <size_t N>
 void Trie<N>::insert(const string &word, const ID &id)
 {
     assert(word.size() == N && "invalid word size");
+    update(word, id, 1);
+}
+
+/**
+ * @brief Insert many words at once, the same as inserting them one by one but
+ * without updating every node on the path of every word. The words below each
+ * first letter are added on their own thread, then the counts of every node
+ * are summed once from its children, bottom up
+ *
+ * @tparam N
+ * @param words fastest when sorted, sorted here otherwise
+ * @param id
+ */
+template <size_t N>
+void Trie<N>::insert(vector<string> words, const ID &id)
+{
+    if (words.empty()) return;
+    if (!is_sorted(words.begin(), words.end())) sort(words.begin(), words.end());
+    assert(all_of(words.begin(), words.end(),
+                  [](const string &word) { return word.size() == N; }) &&
+           "invalid word size");
+
+    // where the words of every first letter start, the children of the root
+    // are created here so that no two threads touch the same node
+    vector<int> starts;
+    for (int i = 0; i < words.size(); i++)
+    {
+        if (i && words[i][0] == words[i - 1][0]) continue;
+        starts.push_back(i);
+        auto &child = root->children[index(words[i][0])];
+        if (!child) child = new Node(-1);
+    }
+    starts.push_back(words.size());
+
+    parallelFor(starts.size() - 1, words.size() * N, [&](int i) {
+        char word[N];
+        word[0] = words[starts[i]][0];
+        Node *child = root->children[index(word[0])];
+        addPaths(child, words.data() + starts[i], words.data() + starts[i + 1], id);
+        aggregate(child, word, 1, id, true);
+    });
+    char word[N];
+    aggregate(root, word, 0, id, false);
+    numberNodes(root);
+    version++;
+}
+
+/**
+ * @brief Create the paths of sorted words below a child of the root and count
+ * the words at their leaves. A word shares the nodes of its common prefix with
+ * the word before it, so only the rest of its path is walked
+ *
+ * @tparam N
+ * @param node the child of the root for the first letter of the words
+ * @param begin
+ * @param end
+ * @param id
+ */
+template <size_t N>
+void Trie<N>::addPaths(Node *node,
+                       const string *begin,
+                       const string *end,
+                       const ID &id)
+{
+    // the nodes on the path of the previous word, by depth
+    Node *path[N + 1];
+    path[1] = node;
+    for (auto word = begin; word != end; word++)
+    {
+        int depth = 1;
+        if (word != begin)
+            while (depth < N && (*word)[depth] == (*(word - 1))[depth]) depth++;
+        for (; depth < N; depth++)
+        {
+            auto &child = path[depth]->children[index((*word)[depth])];
+            if (!child) child = new Node(-1);
+            path[depth + 1] = child;
+        }
+        path[N]->count[id]++;
+        path[N]->isEnd = true;
+    }
+}
+
+/**
+ * @brief Sum the counts of a node from those of its children and summarize
+ * it. The leaves only hold how many times their word was inserted, so the
+ * counts of their parents come from the word itself
+ *
+ * @tparam N
+ * @param node
+ * @param word the letters on the path to the node
+ * @param depth of the node
+ * @param id
+ * @param recurse sum the counts of the children first
+ */
+template <size_t N>
+void Trie<N>::aggregate(Node *node, char *word, int depth, const ID &id, bool recurse)
+{
+    auto &letterCntAtPos = node->letterCntAtPos[id];
+    auto &WordCountWithLetter = node->WordCountWithLetter[id];
+    auto &letterOccuredAtleast = node->letterOccuredAtleast[id];
+    node->count[id] = 0;
+    fill_n(&letterCntAtPos[0][0], N * 26, 0);
+    fill_n(WordCountWithLetter, 26, 0);
+    fill_n(&letterOccuredAtleast[0][0], 26 * (N + 1), 0);
+
+    for (int c = 0; c < 26; c++)
+    {
+        Node *child = node->children[c];
+        if (!child) continue;
+        word[depth] = 'a' + c;
+        if (recurse && depth + 1 < N) aggregate(child, word, depth + 1, id, true);
+        int words = child->count[id];
+        if (!words) continue;
+
+        node->count[id] += words;
+        // every word of the child has the letter after this node
+        for (int l = 0; l < 26; l++)
+            WordCountWithLetter[l] += child->WordCountWithLetter[id][l];
+        WordCountWithLetter[c] += words - child->WordCountWithLetter[id][c];
+        if (depth + 1 == N)
+        {
+            int occurences[26] = { 0 };
+            for (int j = 0; j < N; j++)
+            {
+                int l = index(word[j]);
+                letterCntAtPos[j][l] += words;
+                letterOccuredAtleast[l][++occurences[l]] += words;
+            }
+            continue;
+        }
+        for (int j = 0; j < N; j++)
+            for (int l = 0; l < 26; l++)
+                letterCntAtPos[j][l] += child->letterCntAtPos[id][j][l];
+        for (int l = 0; l < 26; l++)
+            for (int k = 0; k <= N; k++)
+                letterOccuredAtleast[l][k] += child->letterOccuredAtleast[id][l][k];
+    }
+    node->summarize(id);
+}
+
+/**
+ * @brief Give the nodes created by a bulk insert their ids, in alphabetical
+ * order after the nodes that already had one
+ */
+template <size_t N>
+void Trie<N>::numberNodes(Node *node)
+{
+    if (node->id == -1) node->id = nodes++;
+    for (auto &child : node->children)
+        if (child) numberNodes(child);
+}
+
+/**
+ * @brief Remove a word from the trie. The counts and masks along its path are
+ * updated in place, nodes are kept even when empty so the node ids, and the
+ * live counts built on them, stay valid
+ *
+ * @tparam N
+ * @param word
+ * @param id
+ * @return false if the word is not in the trie
+ */
+template <size_t N>
+bool Trie<N>::remove(const string &word, const ID &id)
+{
+    assert(word.size() == N && "invalid word size");
+    if (!count(word, id)) return false;
+    update(word, id, -1);
+    return true;
+}
 
+/**
+ * @brief Add delta to the counts along the path of the word and summarize the
+ * nodes again, creating the missing nodes
+ */
+template <size_t N>
+void Trie<N>::update(const string &word, const ID &id, int delta)
+{
     Node *node = root;
-    node->count[id]++;
+    node->count[id] += delta;
     for (int i = 0; i < N; i++)
     {
         int occurences[26] = { 0 };
         bool seen[26] = { 0 };
         for (int j = 0; j < N; j++)
         {
-            node->letterCntAtPos[id][j][index(word[j])]++;
+            node->letterCntAtPos[id][j][index(word[j])] += delta;
             if (j >= i && !seen[index(word[j])])
             {
-                node->WordCountWithLetter[id][index(word[j])]++;
+                node->WordCountWithLetter[id][index(word[j])] += delta;
                 seen[index(word[j])] = true;
             }
 
             occurences[index(word[j])]++;
             node->letterOccuredAtleast[id][index(word[j])]
-                                      [occurences[index(word[j])]]++;
+                                      [occurences[index(word[j])]] += delta;
         }
+        node->summarize(id);
 
         if (!node->children[index(word[i])])
-            node->children[index(word[i])] = new Node();
+            node->children[index(word[i])] = new Node(nodes++);
         node = node->children[index(word[i])];
-        node->count[id]++;
+        node->count[id] += delta;
     }
     node->isEnd = true;
+    version++;
+}
+
+/**
+ * @brief Add delta to the live counts along the path of the word, words are
+ * added with 1 and eliminated with -1
+ *
+ * @tparam N
+ * @param word must be in the trie
+ * @param live
+ * @param delta
+ */
+template <size_t N>
+void Trie<N>::setLive(const string &word, Live &live, int delta) const
+{
+    Node *node = root;
+    live[node->id] += delta;
+    for (auto &c : word)
+    {
+        node = node->children[index(c)];
+        assert(node && "word not in trie");
+        live[node->id] += delta;
+    }
 }
 
 /**
@@ -149,7 +397,11 @@ Trie<N>::Query::Query(const string &s, const ID &id)
       includesCount(0),
       misplaced(),
       excludes(),
-      letters()
+      letters(),
+      includeMask(0),
+      excludeMask(0),
+      misplacedMask(),
+      needs()
 {
     parse(s);
 }
@@ -204,8 +456,26 @@ void Trie<N>::Query::include(const string &s)
 template <size_t N>
 void Trie<N>::Query::include(const char &c, const int count)
 {
-    if (count > includes[index(c)])
-        includesCount += count - includes[index(c)], includes[index(c)] = count;
+    if (count > includes[index(c)]) setIncludes(index(c), count);
+}
+
+/**
+ * @brief Set how many more times the letter is needed, keeping the masks in
+ * sync
+ *
+ * @tparam N
+ * @param c letter index
+ * @param count
+ */
+template <size_t N>
+void Trie<N>::Query::setIncludes(int c, int count)
+{
+    uint32_t bit = 1u << c;
+    needs[min<int>(includes[c], N)] &= ~bit;
+    includesCount += count - includes[c];
+    includes[c] = count;
+    if (count) needs[min<int>(count, N)] |= bit, includeMask |= bit;
+    else includeMask &= ~bit;
 }
 
 /**
@@ -230,6 +500,7 @@ template <size_t N>
 void Trie<N>::Query::exclude(const char &c)
 {
     excludes[index(c)] = true;
+    excludeMask |= 1u << index(c);
 }
 
 /**
@@ -256,6 +527,7 @@ template <size_t N>
 void Trie<N>::Query::setMisplaced(const char &c, const int &idx)
 {
     misplaced[idx][index(c)] = true;
+    misplacedMask[idx] |= 1u << index(c);
 }
 
 /**
@@ -264,15 +536,53 @@ void Trie<N>::Query::setMisplaced(const char &c, const int &idx)
  * @tparam N
  * @param query
  * @param result provide if you want to store the words
+ * @param live only count these words, optional
  * @return int
  */
 template <size_t N>
-int Trie<N>::count(Query query, vector<string> *result) const
+int Trie<N>::count(Query query, vector<string> *result, const Live *live) const
 {
     string word(N, '.');
     int calls = 0;
-    return _count(query, root, word, calls, result);
+    return _count(query, root, word, calls, result, nullptr, nullptr, nullptr,
+                  nullptr, live);
 }
+/**
+ * @brief Can the subtree be skipped because none of its words match the query
+ *
+ * @tparam N
+ * @param query
+ * @param node
+ * @param idx depth of the node
+ * @return true if no word in the subtree matches
+ */
+template <size_t N>
+bool Trie<N>::prune(const Query &query, const Node *node, int idx) const
+{
+    const ID &id = query.trieId;
+    // not enough letters left
+    if (query.includesCount > N - idx) return true;
+
+    for (int i = idx; i < N; i++)
+    {
+        // fixed letter, but no letter exists in subtree
+        if (query.letters[i] &&
+            !(node->presentAtPos[id][i] >> index(query.letters[i]) & 1))
+            return true;
+        // misplaced letter, but all words have it at that position
+        if (query.misplacedMask[i] & node->everyAtPos[id][i]) return true;
+        // includes letter, but all the words that do have it, have it in misplaced
+        if (query.includeMask & query.misplacedMask[i] & node->onlyAtPos[id][i])
+            return true;
+    }
+    // includes letter, but subtree does not have enough
+    for (int k = 1; k <= N; k++)
+        if (query.needs[k] & ~node->atleast[id][k]) return true;
+    // excludes letter, but all of subtree has it
+    if (query.excludeMask & ~query.includeMask & node->inEvery[id]) return true;
+    return false;
+}
+
 template <size_t N>
 int Trie<N>::_count(
     Query &query,
@@ -289,6 +599,9 @@ int Trie<N>::_count(
     unordered_map<string, int> *memo,
     string *pattern,
 
+    // provide to skip the subtrees without any of these words
+    const Live *live,
+
     int idx) const
 {
     calls++;
@@ -296,45 +609,11 @@ int Trie<N>::_count(
     {
         if (result) result->push_back(word);
         if (memo && pattern) (*memo)[*pattern]++;
+        if (live) return (*live)[node->id];
         return node->count[query.trieId];  // or node->isEnd?
     }
 
-    // not enough letters left
-    if (query.includesCount > N - idx) return 0;
-
-    for (int i = idx; i < 5; i++)
-    {
-        // fixed letter, but no letter exists in subtree
-        if (query.letters[i] &&
-            node->letterCntAtPos[query.trieId][i][index(query.letters[i])] == 0)
-            return 0;
-        // misplaced letter, but all words have it at that position
-        for (int j = 0; j < 26; j++)
-        {
-            if (query.misplaced[i][j] &&
-                node->letterCntAtPos[query.trieId][i][j] ==
-                    node->count[query.trieId])
-                return 0;
-
-            // includes letter, but all the words that do have it, have it in misplaced
-            if (query.includes[j] && query.misplaced[i][j] &&
-                node->letterCntAtPos[query.trieId][i][j] ==
-                    node->WordCountWithLetter[query.trieId][j])
-                return 0;
-        }
-    }
-    for (int i = 0; i < 26; i++)
-    {
-        // includes letter, but subtree does not have enough
-        if (query.includes[i] &&
-            !node->letterOccuredAtleast[query.trieId][i][query.includes[i]])
-            return 0;
-        // excludes letter, but all of subtree has it
-        if (query.excludes[i] && !query.includes[i] &&
-            node->WordCountWithLetter[query.trieId][i] ==
-                node->count[query.trieId])
-            return 0;
-    }
+    if (prune(query, node, idx)) return 0;
 
     int sum = 0;
     bool flag = false;
@@ -343,11 +622,13 @@ int Trie<N>::_count(
     {
         if (!node->children[i] || node->children[i]->count[query.trieId] == 0)
             continue;
+        // every word below was eliminated
+        if (isDead(node->children[i], live)) continue;
         if (!query.verify('a' + i, idx)) continue;
 
         // prepare to traverse the next node
         if (query.includes[i])
-            query.includes[i]--, query.includesCount--, flag = true;
+            query.setIncludes(i, query.includes[i] - 1), flag = true;
         word[idx] = 'a' + i;
 
         int removedIdx = -1;
@@ -395,11 +676,11 @@ int Trie<N>::_count(
 
         // traverse the next node
         sum += _count(query, node->children[i], word, calls, result, guess,
-                      guessLetters, memo, pattern, idx + 1);
+                      guessLetters, memo, pattern, live, idx + 1);
 
         // undo the changes
         word[idx] = '.';
-        if (flag) query.includes[i]++, query.includesCount++, flag = false;
+        if (flag) query.setIncludes(i, query.includes[i] + 1), flag = false;
 
         if (removedIdx != -1 && prevMissPattern != -1)
             (*pattern)[removedIdx] = prevMissPattern;
@@ -445,7 +726,8 @@ void Trie<N>::Query::print() const
 
 template <size_t N>
 unordered_map<string, int> Trie<N>::getPatternsCounts(const string &guess,
-                                            Query &SampleSpace) const
+                                            Query &SampleSpace,
+                                            const Live *live) const
 {
     unordered_map<string, int> memo;
     string pattern(N, TileType::NONE);
@@ -456,7 +738,7 @@ unordered_map<string, int> Trie<N>::getPatternsCounts(const string &guess,
     for (int i = N - 1; i >= 0; i--) guessLetters[index(guess[i])].insert(i);
 
     _count(SampleSpace, root, word, calls, nullptr, &guess, &guessLetters,
-           &memo, &pattern);
+           &memo, &pattern, live);
     // cout << "Calls: " << calls << endl;
     return memo;
 }
@@ -488,10 +770,10 @@ bool Trie<N>::Query::verify(const string &word)
             break;
         }
         if (includes[index(word[i])])
-            includes[index(word[i])]--, includesCount--,
+            setIncludes(index(word[i]), includes[index(word[i])] - 1),
                 included.push_back(index(word[i]));
     }
-    for (auto &i : included) includes[i]++, includesCount++;
+    for (auto &i : included) setIncludes(i, includes[i] + 1);
     return flag;
 }
 
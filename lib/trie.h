@@ -1,7 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <unordered_map>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -23,6 +25,8 @@ class Trie {
         void print() const;
         bool verify(const string &word);
         string serialize() const;
+        // the same constraints, without serializing either query
+        bool operator==(const Query &other) const = default;
 
        private:
         Query(const string &s, const ID &id);
@@ -32,20 +36,45 @@ class Trie {
         bool misplaced[N][26];
         bool excludes[26];
         char letters[N];
+        // the same constraints as letter masks, bit c is the letter 'a' + c,
+        // kept in sync so pruning a node is a few mask operations
+        uint32_t includeMask;
+        uint32_t excludeMask;
+        uint32_t misplacedMask[N];
+        // letters that are still needed exactly k more times
+        uint32_t needs[N + 1];
         bool verify(const char &c, const int &idx) const;
+        void setIncludes(int c, int count);
 
         static const char delim = '#';
         friend class Trie<N>;
     };
 
+    // how many words of a subset are below every node, by node id. lets
+    // traversals skip subtrees whose words were all eliminated
+    typedef vector<int> Live;
+
     Trie();
     void insert(const string &word, const ID &id);
-    int count(Query query, vector<string> *result = nullptr) const;
+    void insert(vector<string> words, const ID &id);
+    bool remove(const string &word, const ID &id);
+    int count(Query query,
+              vector<string> *result = nullptr,
+              const Live *live = nullptr) const;
     int count(const string &word, const ID &id) const;
+    template <typename Visitor>
+    int forEach(Query query, Visitor &&visit, const Live *live = nullptr) const;
     unordered_map<string, int> getPatternsCounts(const string &word,
-                                       Query &SampleSpace) const;
+                                       Query &SampleSpace,
+                                       const Live *live = nullptr) const;
+    Live getLive() const { return Live(nodes, 0); }
+    int getNodeCount() const { return nodes; }
+    size_t getMemoryUsage() const { return nodes * sizeof(Node); }
+    void setLive(const string &word, Live &live, int delta) const;
     string getNthWord(int n, const ID &id) const;
     Query query(const string s, const ID &id) const;
+    // changes whenever a word is inserted or removed
+    int getVersion() const { return version; }
 
     ~Trie();
 
@@ -59,8 +88,24 @@ class Trie {
         int WordCountWithLetter[2][26];
         // how many words have atleast this many occurences of the letter in the subtree
         int letterOccuredAtleast[2][26][N + 1];
+
+        // summaries of the counts above as letter masks, bit c is 'a' + c
+        // letters some word has at the position
+        uint32_t presentAtPos[2][N];
+        // letters every word has at the position
+        uint32_t everyAtPos[2][N];
+        // letters that, in every word that has them after the node, are at
+        // the position
+        uint32_t onlyAtPos[2][N];
+        // letters every word has after the node
+        uint32_t inEvery[2];
+        // letters some word has atleast k times
+        uint32_t atleast[2][N + 1];
         bool isEnd;
-        Node();
+        // position in Live
+        int id;
+        Node(int id);
+        void summarize(const ID &id);
 
         ~Node();
     };
@@ -74,7 +119,27 @@ class Trie {
     };
 
     Node *root;
+    int nodes = 0;
+    int version = 0;
     static int index(const char &c);
+    void update(const string &word, const ID &id, int delta);
+    void addPaths(Node *node, const string *begin, const string *end, const ID &id);
+    void aggregate(Node *node, char *word, int depth, const ID &id, bool recurse);
+    void numberNodes(Node *node);
+    // nodes created after the live counts were built hold none of their words
+    static bool isDead(const Node *node, const Live *live)
+    {
+        return live && (node->id >= live->size() || !(*live)[node->id]);
+    }
+    bool prune(const Query &query, const Node *node, int idx) const;
+    template <typename Visitor>
+    bool _forEach(Query &query,
+                  const Node *node,
+                  char *word,
+                  int &visited,
+                  Visitor &visit,
+                  const Live *live,
+                  int idx = 0) const;
     int _count(Query &query,
                Node *node,
                string &word,
@@ -84,5 +149,61 @@ class Trie {
                set<int> (*guessLetters)[26] = nullptr,
                unordered_map<string, int> *memo = nullptr,
                string *pattern = nullptr,
+               const Live *live = nullptr,
                int idx = 0) const;
 };
+
+/**
+ * @brief Visit the words that match the query in alphabetical order, without
+ * copying them. The view is only valid during the call, return false from the
+ * visitor to stop early
+ *
+ * @tparam N
+ * @param query
+ * @param visit called with a string_view of each word, returns bool
+ * @param live only visit these words, optional
+ * @return int number of words visited
+ */
+template <size_t N>
+template <typename Visitor>
+int Trie<N>::forEach(Query query, Visitor &&visit, const Live *live) const
+{
+    char word[N];
+    int visited = 0;
+    _forEach(query, root, word, visited, visit, live);
+    return visited;
+}
+
+template <size_t N>
+template <typename Visitor>
+bool Trie<N>::_forEach(Query &query,
+                       const Node *node,
+                       char *word,
+                       int &visited,
+                       Visitor &visit,
+                       const Live *live,
+                       int idx) const
+{
+    if (idx == N)
+    {
+        visited++;
+        return visit(string_view(word, N));
+    }
+    if (prune(query, node, idx)) return true;
+
+    for (int i = 0; i < 26; i++)
+    {
+        const Node *child = node->children[i];
+        if (!child || child->count[query.trieId] == 0) continue;
+        if (isDead(child, live)) continue;
+        if (!query.verify('a' + i, idx)) continue;
+
+        bool included = query.includes[i];
+        if (included) query.setIncludes(i, query.includes[i] - 1);
+        word[idx] = 'a' + i;
+        bool more = _forEach(query, child, word, visited, visit, live, idx + 1);
+        if (included) query.setIncludes(i, query.includes[i] + 1);
+        if (!more) return false;
+    }
+    return true;
+}
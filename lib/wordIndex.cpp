@@ -0,0 +1,128 @@
+#include "wordIndex.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+/**
+ * @brief Build the index, duplicates and invalid words are dropped
+ *
+ * @tparam N
+ * @param list
+ */
+template <size_t N>
+WordIndex<N>::WordIndex(vector<string> list)
+{
+    for (auto &word : list)
+        if (uint32_t p = pack(word)) words.push_back(p);
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    order.resize(words.size());
+    for (int i = 0; i < words.size(); i++) order[i] = i;
+    rehash();
+}
+
+template <size_t N>
+void WordIndex<N>::rehash()
+{
+    // keep the load factor under half so probes stay short
+    size_t capacity = 1;
+    while (capacity < 2 * words.size()) capacity <<= 1;
+    table.assign(capacity, -1);
+    for (int i = 0; i < words.size(); i++)
+    {
+        size_t s = slot(words[i]);
+        while (table[s] != -1) s = (s + 1) & (table.size() - 1);
+        table[s] = i;
+    }
+}
+
+/**
+ * @brief Intern a word after the index was built. It gets the next id, so
+ * ids no longer follow the alphabet, see getOrder
+ *
+ * @tparam N
+ * @param word
+ * @return int id of the word, -1 if it is not a valid word
+ */
+template <size_t N>
+int WordIndex<N>::add(const string &word)
+{
+    uint32_t p = pack(word);
+    if (!p) return -1;
+    if (int existing = id(p); existing != -1) return existing;
+
+    int added = words.size();
+    words.push_back(p);
+    auto before = [this](uint32_t value, int i) { return value < words[i]; };
+    order.insert(upper_bound(order.begin(), order.end(), p, before), added);
+    if (2 * words.size() > table.size()) rehash();
+    else
+    {
+        size_t s = slot(p);
+        while (table[s] != -1) s = (s + 1) & (table.size() - 1);
+        table[s] = added;
+    }
+    return added;
+}
+
+/**
+ * @brief Pack a word into 5 bits per letter, 0 if it is not a valid word
+ *
+ * @tparam N
+ * @param word
+ * @return uint32_t
+ */
+template <size_t N>
+uint32_t WordIndex<N>::pack(string_view word)
+{
+    if (word.size() != N) return 0;
+    uint32_t packed = 0;
+    for (auto &c : word)
+    {
+        if (c < 'a' || c > 'z') return 0;
+        // letters start at 1 so that 0 is never a word
+        packed = packed << 5 | (c - 'a' + 1);
+    }
+    return packed;
+}
+
+template <size_t N>
+string WordIndex<N>::unpack(uint32_t packed)
+{
+    string word(N, '.');
+    for (int i = 0; i < N; i++) word[i] = 'a' + letter(packed, i);
+    return word;
+}
+
+template <size_t N>
+size_t WordIndex<N>::slot(uint32_t packed) const
+{
+    uint32_t hash = packed * 2654435769u;
+    return (hash ^ hash >> 15) & (table.size() - 1);
+}
+
+/**
+ * @brief id of the word, -1 if it is not in the index
+ *
+ * @tparam N
+ * @param word
+ * @return int
+ */
+template <size_t N>
+int WordIndex<N>::id(const string &word) const
+{
+    uint32_t p = pack(word);
+    return p ? id(p) : -1;
+}
+
+template <size_t N>
+int WordIndex<N>::id(uint32_t packed) const
+{
+    if (table.empty()) return -1;
+    for (size_t s = slot(packed); table[s] != -1; s = (s + 1) & (table.size() - 1))
+        if (words[table[s]] == packed) return table[s];
+    return -1;
+}
+
+template class WordIndex<5>;
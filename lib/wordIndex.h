@@ -0,0 +1,63 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Interns words of length N as dense ids. Each word is packed into 5
+ * bits per letter, first letter in the highest bits, so packed words sort
+ * alphabetically and the id of a word is its alphabetical position. Words
+ * added later get the next ids, ids never change once given.
+ */
+template <size_t N>
+class WordIndex {
+    static_assert(N * 5 <= 32, "word does not fit in 32 bits");
+
+   public:
+    WordIndex() = default;
+    explicit WordIndex(vector<string> words);
+
+    static uint32_t pack(string_view word);
+    static string unpack(uint32_t packed);
+    static int letter(uint32_t packed, int idx);
+
+    int add(const string &word);
+    int id(const string &word) const;
+    int id(uint32_t packed) const;
+    uint32_t packed(int id) const { return words[id]; }
+    string word(int id) const { return unpack(words[id]); }
+    int size() const { return words.size(); }
+    // ids in alphabetical order
+    const vector<int> &getOrder() const { return order; }
+    size_t getMemoryUsage() const
+    {
+        return words.capacity() * sizeof(uint32_t) +
+               (table.capacity() + order.capacity()) * sizeof(int);
+    }
+
+   private:
+    // sorted, the position of a word is its id. added words are appended
+    vector<uint32_t> words;
+    // open addressing from packed word to id, -1 if empty
+    vector<int> table;
+    // the identity until words are added
+    vector<int> order;
+
+    size_t slot(uint32_t packed) const;
+    void rehash();
+};
+
+/**
+ * @brief letter at the given index, 0 for 'a'. In the header so that the
+ * pattern loops, which call it for every pair of words, can inline it
+ */
+template <size_t N>
+int WordIndex<N>::letter(uint32_t packed, int idx)
+{
+    assert(idx >= 0 && idx < N && "invalid index");
+    return (packed >> (5 * (N - 1 - idx)) & 31) - 1;
+}
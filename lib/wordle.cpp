@@ -1,17 +1,67 @@
 #include "wordle.h"
+#include <algorithm>
+#include <bitset>
+#include <cassert>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <queue>
+#include <iterator>
+#include <mutex>
 #include <random>
+#include <sstream>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <unordered_set>
 #include "ProgressBar.h"
+#include "cacheLog.h"
+#include "parallel.h"
+#include "sharedCache.h"
 
 using namespace std;
 
 const int titleWidth = 23, numWidth = 5;
 const string EntropyCache = "entropy_cache.txt";
+// adversarial rankings are cached under the key of the state with this suffix
+const string adversarialSuffix = "-adversarial";
+// sampled rankings can miss a guess whose estimate was off, they are cached
+// apart from exact rankings under the key of the state with this suffix
+const string sampledSuffix = "-sampled";
+// states with at most this many words group their guesses into classes. a
+// guess has few ways to split so few words, thousands of guesses collapse into
+// a few hundred classes, while a larger state pays for a partition per guess
+// and saves little
+const int classMaxWords = 16;
+// standard deviations covered by a sampled entropy interval
+const double sampleDeviations = 4;
+
+// tokens on a line of the cache file
+static int countTokens(const string &line)
+{
+    istringstream in(line);
+    return distance(istream_iterator<string>(in), istream_iterator<string>());
+}
+
+// a word of the cache file without its id. older caches do not have the
+// largest bucket, it is left unknown
+static Wordle::Word readWord(istream &in, int fields)
+{
+    Wordle::Word word;
+    in >> word.word >> word.score >> word.entropy >> word.maxEntropy;
+    if (fields > 4) in >> word.maxBucket;
+    return word;
+}
+
+// word lists locked by the calls in progress on this thread, and whether
+// they are held exclusive
+static thread_local vector<pair<const shared_mutex *, bool>> heldWords;
+
+// bytes a string keeps outside of itself
+static size_t heapBytes(const string &s)
+{
+    return s.capacity() > string().capacity() ? s.capacity() + 1 : 0;
+}
 
 Wordle::Wordle(const string &filepath,
                const string &possibleFilepath,
@@ -31,14 +81,13 @@ Wordle::Wordle(const string &allowedFilepath,
     : targetWord(targetWord),
       guesses(0),
       status(GameStatus::ONGOING),
-      wordTrie()
+      wordTrie(make_shared<Trie<N>>()),
+      cache(make_shared<Cache>())
 {
     stats.reserve(maxGuesses + 1);
-    cache.cachePath = cacheFilepath;
+    cache->cachePath = cacheFilepath;
 
-    // check if cache exists
-    bool cached = loadCache();
-    if (cached) wordlist = cache.wordlistCache;
+    vector<string> allowedWords, possibleWords;
 
     ifstream allowedFile(allowedFilepath);
     if (!allowedFile.is_open())
@@ -48,18 +97,9 @@ Wordle::Wordle(const string &allowedFilepath,
     }
 
     string allowedWord;
-    while (allowedFile >> allowedWord)
-    {
-        wordTrie.insert(allowedWord, allowedID);
-        if (!cached)
-            wordlist.push({
-                .word = allowedWord,
-                .score = -1,
-                .entropy = -1,
-                .maxEntropy = -1,
-            });
-    }
+    while (allowedFile >> allowedWord) allowedWords.push_back(allowedWord);
     allowedFile.close();
+    wordTrie->insert(allowedWords, allowedID);
 
     if (!possibleFilepath.empty())
     {
@@ -72,13 +112,88 @@ Wordle::Wordle(const string &allowedFilepath,
         }
 
         string possibleWord;
-        while (possibleFile >> possibleWord)
-            wordTrie.insert(possibleWord, possibleID);
+        while (possibleFile >> possibleWord) possibleWords.push_back(possibleWord);
+        wordTrie->insert(possibleWords, possibleID);
     }
+    else possibleWords = allowedWords;
 
-    int count = wordTrie.count("", possibleID);
+    vector<string> words = allowedWords;
+    words.insert(words.end(), possibleWords.begin(), possibleWords.end());
+    wordIndex = make_shared<WordIndex<N>>(words);
+    auto allowed = make_shared<vector<bool>>(wordIndex->size()),
+         possible = make_shared<vector<bool>>(wordIndex->size());
+    // words that are not N lowercase letters have no id
+    for (auto &word : allowedWords)
+        if (int id = wordIndex->id(word); id != -1) (*allowed)[id] = true;
+    for (auto &word : possibleWords)
+        if (int id = wordIndex->id(word); id != -1) (*possible)[id] = true;
+    isAllowed = allowed, isPossible = possible;
 
-    stats.push_back({
+    // check if cache exists
+    bool cached = loadCache();
+    // the log can outlive this engine in its copies, it holds on to the cache
+    if (!cache->cachePath.empty())
+        cacheLog = make_shared<CacheLog>(
+            cache->cachePath,
+            [cache = cache](ostream &out) { return writeCache(*cache, out); },
+            [cache = cache, index = wordIndex, allowed = isAllowed](
+                istream &snapshot, istream &log) {
+                WordsLock words(cache->wordsMutex, false);
+                // the files were written for other word lists, they are
+                // replaced instead
+                if (cache->wordsChanged) return;
+                unique_lock lock(cache->mutex);
+                // the ranking of the snapshot comes first, this engine's is kept
+                for (string line; getline(snapshot, line) &&
+                                  !line.starts_with("#####");)
+                    ;
+                readEntries(*cache, *index, *allowed, snapshot, true);
+                readEntries(*cache, *index, *allowed, log, true);
+            });
+
+    stats.push_back(getInitialStat());
+    cache->rootKey = stats.back().key;
+    // the cached ranking holds the entropies of the initial state
+    if (cached)
+    {
+        storeEntropies(stats.back().key, *cache->ranking);
+        return;
+    }
+
+    cout << "Pre-calculating entropy..." << endl;
+    ProgressBar progressBar(allowedWords.size());
+    progressBar.update(0);
+    vector<Word> ranking;
+    ranking.reserve(allowedWords.size());
+    for (auto &word : allowedWords)
+    {
+        ranking.push_back(getEntropy(stats.back(), word));  // expensive
+        progressBar.update(ranking.size());
+    }
+    progressBar.finish();
+    storeEntropies(stats.back().key, ranking);
+
+    // a single pattern stays a single pattern, they can never be useful
+    erase_if(ranking, [this](const Word &word) {
+        return feq(word.maxEntropy, 0) && !isInWordSpace(word.id, stats[0]);
+    });
+    sort(ranking.begin(), ranking.end(),
+         [](const Word &a, const Word &b) { return b < a; });
+    cache->ranking = make_shared<const vector<Word>>(move(ranking));
+
+    saveCache();
+}
+
+/**
+ * @brief the state before any guess, on the current word lists
+ */
+Wordle::Stat Wordle::getInitialStat() const
+{
+    int count = wordTrie->count("", possibleID);
+    auto query = wordTrie->query("", possibleID);
+    auto candidates = getCandidates(query);
+
+    return {
         .guess = "",
         .pattern = "",
         .count = count,
@@ -86,109 +201,419 @@ Wordle::Wordle(const string &allowedFilepath,
         .bits = 0,
         .entropy = 0,
         .remainingBits = log2(count),
-        .query = wordTrie.query("", possibleID),
+        .query = query,
+        .key = getStateKey(*candidates),
+        .candidates = candidates,
+        .live = getLive(nullptr, *candidates),
+        .classes = count <= classMaxWords ? getClasses(nullptr, *candidates)
+                                          : nullptr,
+        .version = wordTrie->getVersion(),
+        .parent = "",
+        .turn = 0,
         .valid = true,
-    });
+    };
+}
 
-    // save cache
-    if (!cached)
-    {
-        cout << "Pre-calculating entropy..." << endl;
-        getTopNWords(0, true);
-        cache.wordlistCache = wordlist;
-        saveCache();
-    }
+/**
+ * @brief was the game of the state started before the words last changed
+ */
+bool Wordle::isStale(const Stat &stat) const
+{
+    return stat.version != wordTrie->getVersion();
 }
 
 bool Wordle::loadCache()
 {
-    fstream cacheFile(cache.cachePath, ios::in);
+    fstream cacheFile(cache->cachePath, ios::in);
     if (!cacheFile.is_open()) return false;
 
     cout << "WARN: Using cached entropy values from "
             "file: "
-         << filesystem::absolute(cache.cachePath) << endl;
-
-    string word;
-    double score, entropy, maxEntropy;
-    while (cacheFile >> word >> score >> entropy >> maxEntropy &&
-           word != "#####")
-        cache.wordlistCache.push({
-            .word = word,
-            .score = score,
-            .entropy = entropy,
-            .maxEntropy = maxEntropy,
-        });
+         << filesystem::absolute(cache->cachePath) << endl;
+
+    unique_lock lock(cache->mutex);
+    string line;
+    vector<Word> ranking;
+    while (getline(cacheFile, line))
+    {
+        istringstream in(line);
+        auto word = readWord(in, countTokens(line));
+        if (!in || word.word == "#####") break;
+        word.id = wordIndex->id(word.word);
+        ranking.push_back(word);
+    }
+    // saved in order, but older caches were written from a heap
+    stable_sort(ranking.begin(), ranking.end(),
+                [](const Word &a, const Word &b) { return b < a; });
+    cache->ranking = make_shared<const vector<Word>>(move(ranking));
+
+    readEntries(*cache, *wordIndex, *isAllowed, cacheFile, false);
+    cacheFile.close();
+
+    ifstream logFile(CacheLog::logPath(cache->cachePath));
+    if (logFile.is_open())
+        readEntries(*cache, *wordIndex, *isAllowed, logFile, false);
 
-    string query;
+    return true;
+}
+
+/**
+ * @brief Read the entries of a snapshot after its ranking, or of a log. A
+ * crash can leave the last entry of the log incomplete, reading stops there.
+ * Entries with a word that is not an allowed guess are skipped. The caller
+ * holds the cache lock
+ *
+ * @param merge keep the entries of the cache that ranked as many words
+ */
+void Wordle::readEntries(Cache &cache,
+                         const WordIndex<N> &index,
+                         const vector<bool> &allowed,
+                         istream &file,
+                         bool merge)
+{
+    string key, line;
     int n, count;
-    while (cacheFile >> query >> n >> count)
+    while (file >> key >> n >> count)
     {
+        // the words of an entry are on the line after its header
+        if (!count) line.clear();
+        else if (!getline(file >> ws, line)) break;
+        int fields = count ? countTokens(line) / count : 4;
+        if ((fields != 4 && fields != 5) || countTokens(line) != fields * count)
+            break;
+
+        istringstream in(line);
         vector<Word> words;
         words.reserve(count);
+        bool known = true;
         for (int i = 0; i < count; i++)
         {
-            cacheFile >> word >> score >> entropy >> maxEntropy;
-            words.push_back({
-                .word = word,
-                .score = score,
-                .entropy = entropy,
-                .maxEntropy = maxEntropy,
-            });
+            auto &word = words.emplace_back(readWord(in, fields));
+            word.id = index.id(word.word);
+            known = known && word.id != -1 && allowed[word.id];
         }
-        cache.TopWordsCache[query] = {
-            .n = n,
-            .words = words,
-        };
+        // older caches were keyed by the serialized query
+        if (!known || key.find('#') != string::npos) continue;
+        auto it = cache.TopWordsCache.find(key);
+        if (merge && it != cache.TopWordsCache.end() && it->second.n >= n)
+            continue;
+        storeTopWords(cache, key, {
+                                      .n = n,
+                                      .words = words,
+                                  });
     }
-    cacheFile.close();
-
-    return true;
 }
 
+/**
+ * @brief Compact the cache file now. New entries are persisted in the
+ * background anyway, this is only needed to shrink the log
+ */
 bool Wordle::saveCache() const
 {
-    fstream cacheFile(cache.cachePath, ios::out | ios::trunc);
-    if (!cacheFile.is_open()) return false;
+    return cacheLog && cacheLog->compact();
+}
 
-    auto cp = cache.wordlistCache;
-    while (!cp.empty())
+/**
+ * @brief Write the whole cache, the ranking then every entry
+ *
+ * @return int number of entries, -1 if there is no ranking yet
+ */
+int Wordle::writeCache(const Cache &cache, ostream &cacheFile)
+{
+    shared_lock lock(cache.mutex);
+    if (!cache.ranking) return -1;
+    for (auto &word : *cache.ranking)
     {
-        auto word = cp.top();
-        cp.pop();
         cacheFile << word.word << " " << setprecision(17) << word.score << " "
                   << setprecision(17) << word.entropy << " " << setprecision(17)
-                  << word.maxEntropy << endl;
+                  << word.maxEntropy << " " << word.maxBucket << endl;
     }
 
-    cacheFile << "##### -1 -1 -1" << endl;
+    cacheFile << "##### -1 -1 -1 -1" << endl;
 
-    for (auto &[query, topWords] : cache.TopWordsCache)
+    for (auto &[key, topWords] : cache.TopWordsCache)
+        cacheFile << serializeEntry(key, topWords);
+    return cache.TopWordsCache.size();
+}
+
+string Wordle::serializeEntry(const string &key, const TopWords &topWords)
+{
+    stringstream entry;
+    entry << key << " " << topWords.n << " " << topWords.words.size() << endl;
+    for (auto &word : topWords.words)
+        entry << word.word << " " << setprecision(17) << word.score << " "
+              << setprecision(17) << word.entropy << " " << setprecision(17)
+              << word.maxEntropy << " " << word.maxBucket << " ";
+    entry << endl;
+    return entry.str();
+}
+
+/**
+ * @brief Attach to the shared memory cache of the solver processes on this
+ * machine, creating it if needed. Results are only shared between engines
+ * with the same word lists
+ *
+ * @param name shm name, eg. "/wordle_cache"
+ * @param capacity number of states the segment can hold
+ * @return true if the cache is used
+ */
+bool Wordle::openSharedCache(const string &name, size_t capacity)
+{
+    auto shared = make_shared<SharedCache>();
+    if (!shared->open(name, getFingerprint(), capacity)) return false;
+    sharedCache = shared;
+    return true;
+}
+
+/**
+ * @brief hash of the word lists, ids only mean the same word in engines with
+ * the same fingerprint
+ */
+uint64_t Wordle::getFingerprint() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int id = 0; id < wordIndex->size(); id++)
     {
-        cacheFile << query << " " << topWords.n << " " << topWords.words.size()
-                  << endl;
-        for (auto &word : topWords.words)
-            cacheFile << word.word << " " << setprecision(17) << word.score
-                      << " " << setprecision(17) << word.entropy << " "
-                      << setprecision(17) << word.maxEntropy << " ";
-        cacheFile << endl;
+        uint64_t word = (uint64_t)wordIndex->packed(id) << 2 |
+                        (*isAllowed)[id] << 1 | (*isPossible)[id];
+        for (int i = 0; i < 8; i++, word >>= 8)
+            hash = (hash ^ (word & 255)) * 1099511628211ull;
     }
+    return hash;
+}
 
-    cacheFile.close();
+/**
+ * @brief Add and remove words while the engine runs. The trie, the word ids
+ * and the ranking of the initial state are updated in place, and only the
+ * cached rankings a changed guess could be part of are dropped, the others are
+ * keyed by their remaining words and still hold. A game in progress keeps its
+ * words less the removed ones, the next game plays on the new words. Copies
+ * share the words, their calls wait for the update to finish
+ *
+ * @param added
+ * @param removed
+ * @param possible change the possible words, added words are also allowed.
+ * Otherwise change the allowed words, removed words can no longer be the
+ * answer either
+ * @return int number of words that changed
+ */
+int Wordle::updateWords(const vector<string> &added,
+                        const vector<string> &removed,
+                        bool possible)
+{
+    auto lock = lockWords(true);
+    vector<int> addedPossible, removedPossible, addedAllowed, removedAllowed;
+    int indexed = wordIndex->size();
+    // with one list every allowed word can be the answer
+    bool oneList = possibleID == allowedID;
+    auto setAllowed = [&](int id, bool value) {
+        if ((*isAllowed)[id] == value) return;
+        if (value) wordTrie->insert(wordIndex->word(id), allowedID);
+        else wordTrie->remove(wordIndex->word(id), allowedID);
+        (*isAllowed)[id] = value;
+        (value ? addedAllowed : removedAllowed).push_back(id);
+        if (!oneList) return;
+        (*isPossible)[id] = value;
+        (value ? addedPossible : removedPossible).push_back(id);
+    };
+    auto setPossible = [&](int id, bool value) {
+        if (oneList) return setAllowed(id, value);
+        if ((*isPossible)[id] == value) return;
+        if (value) wordTrie->insert(wordIndex->word(id), possibleID);
+        else wordTrie->remove(wordIndex->word(id), possibleID);
+        (*isPossible)[id] = value;
+        (value ? addedPossible : removedPossible).push_back(id);
+    };
+    auto changes = [&] {
+        return addedPossible.size() + removedPossible.size() +
+               addedAllowed.size() + removedAllowed.size();
+    };
 
-    return true;
+    int changed = 0;
+    for (auto &word : added)
+    {
+        int id = wordIndex->add(word);
+        if (id == -1) continue;
+        isAllowed->resize(wordIndex->size());
+        isPossible->resize(wordIndex->size());
+        size_t before = changes();
+        setAllowed(id, true);
+        if (possible) setPossible(id, true);
+        changed += changes() > before;
+    }
+    for (auto &word : removed)
+    {
+        int id = wordIndex->id(word);
+        if (id == -1) continue;
+        size_t before = changes();
+        setPossible(id, false);
+        if (!possible) setAllowed(id, false);
+        changed += changes() > before;
+    }
+    if (!changed) return 0;
+    cache->wordsChanged = true;
+
+    updateRanking(addedPossible, removedPossible, addedAllowed, removedAllowed);
+    updatePossibleWords(addedPossible, removedPossible);
+    // the results of the other processes hold for the same ids and guesses
+    if (sharedCache && sharedCache->isOpen() &&
+        (wordIndex->size() != indexed || !addedAllowed.empty() ||
+         !removedAllowed.empty()))
+    {
+        sharedCache->close();
+        cout << "WARN: Shared cache closed, the allowed words changed" << endl;
+    }
+    // the snapshot holds the ranking, it is written again in the background
+    if (cacheLog) cacheLog->requestCompaction();
+    if (!guesses)
+    {
+        reset();
+        // a game that has not started does not keep a removed answer
+        int id = wordIndex->id(targetWord);
+        if (!targetWord.empty() && (id == -1 || !(*isPossible)[id]))
+            setRandomTargetWord();
+    }
+    return changed;
 }
 
-bool Wordle::isWordValid(const string &word)
+/**
+ * @brief Bring the ranking of the initial state up to date after the words
+ * changed. The histogram of a guess only changes in the patterns of the words
+ * that became possible or no longer are, so only those are counted again
+ */
+void Wordle::updateRanking(const vector<int> &addedPossible,
+                           const vector<int> &removedPossible,
+                           const vector<int> &addedAllowed,
+                           const vector<int> &removedAllowed)
 {
-    if (word.size() != N) return false;
+    auto initial = getInitialStat();
+    vector<uint32_t> words;
+    for (int id : getCandidateIds(initial)) words.push_back(wordIndex->packed(id));
 
-    for (auto &c : word)
-        if (!islower(c)) return false;
+    auto &histograms = cache->rootCounts;
+    histograms.resize(wordIndex->size());
+    vector<int> ids;
+    long long work = 0;
+    for (int id = 0; id < wordIndex->size(); id++)
+    {
+        if (!(*isAllowed)[id]) histograms[id].built = false;
+        else
+        {
+            ids.push_back(id);
+            work += histograms[id].built
+                        ? addedPossible.size() + removedPossible.size()
+                        : words.size();
+        }
+    }
+    // E = log2(total) - sum(count * log2(count)) / total
+    auto weight = [](int count) { return count ? count * log2(count) : 0.0; };
+    vector<Word> entropies(ids.size());
+    parallelFor(ids.size(), work, [&](int i) {
+        auto &histogram = histograms[ids[i]];
+        auto &counts = histogram.counts;
+        uint32_t guess = wordIndex->packed(ids[i]);
+        if (histogram.built)
+        {
+            auto add = [&](int id, int delta) {
+                int &count = counts[getPatternCode(guess, wordIndex->packed(id))];
+                histogram.patterns -= count > 0;
+                histogram.weighted -= weight(count);
+                count += delta;
+                histogram.patterns += count > 0;
+                histogram.weighted += weight(count);
+                histogram.maxBucket = max(histogram.maxBucket, count);
+            };
+            for (int id : addedPossible) add(id, 1);
+            for (int id : removedPossible) add(id, -1);
+            if (!removedPossible.empty())
+                histogram.maxBucket = *max_element(begin(counts), end(counts));
+        }
+        else
+        {
+            fill(begin(counts), end(counts), 0);
+            for (auto &word : words) counts[getPatternCode(guess, word)]++;
+            histogram.patterns = histogram.maxBucket = histogram.weighted = 0;
+            for (int count : counts)
+            {
+                histogram.patterns += count > 0;
+                histogram.weighted += weight(count);
+                histogram.maxBucket = max(histogram.maxBucket, count);
+            }
+            histogram.built = true;
+        }
 
+        int total = max<int>(words.size(), 1);
+        double entropy = log2(total) - histogram.weighted / total;
+        entropies[i] = {
+            .word = wordIndex->word(ids[i]),
+            .score = entropy,
+            .entropy = entropy,
+            .maxEntropy = log2(max(histogram.patterns, 1)),
+            .maxBucket = histogram.maxBucket,
+            .id = ids[i],
+        };
+    });
+
+    auto ranking = entropies;
+    erase_if(ranking, [&](const Word &word) {
+        return feq(word.maxEntropy, 0) && !isInWordSpace(word.id, initial);
+    });
+    sort(ranking.begin(), ranking.end(),
+         [](const Word &a, const Word &b) { return b < a; });
+
+    // a guess has no more patterns in a state than in the initial state, so
+    // a ranking only gains an added guess if its bound reaches the last word
+    double bound = -INFINITY;
+    for (int id : addedAllowed)
+        bound = max(bound, log2(max(histograms[id].patterns, 1)));
+    unordered_set<int> removedGuesses(removedAllowed.begin(), removedAllowed.end());
+    auto affected = [&](const string &key, const TopWords &entry) {
+        for (auto &word : entry.words)
+            if (removedGuesses.contains(word.id)) return true;
+        if (addedAllowed.empty()) return false;
+        // ordered by the largest bucket, which the bound says nothing about
+        if (key.ends_with(adversarialSuffix) || entry.words.size() < entry.n)
+            return true;
+        double least = INFINITY;
+        for (auto &word : entry.words) least = min(least, word.entropy);
+        return bound >= least - 1e-6;
+    };
+
+    {
+        unique_lock lock(cache->mutex);
+        erase_if(cache->TopWordsCache, [&](const auto &entry) {
+            if (!affected(entry.first, entry.second)) return false;
+            cache->topWordsBytes -= getEntryBytes(entry.first, entry.second);
+            return true;
+        });
+        erase_if(cache->topWordsOrder, [&](const string &key) {
+            return !cache->TopWordsCache.contains(key);
+        });
+
+        // only games started before the update are still in the old state
+        if (cache->rootKey != initial.key)
+        {
+            auto it = cache->EntropyCache.find(cache->rootKey);
+            if (it != cache->EntropyCache.end())
+            {
+                cache->entropyBytes -= getEntryBytes(it->first, *it->second);
+                cache->EntropyCache.erase(it);
+            }
+            erase_if(cache->entropyOrder,
+                     [&](const string &key) { return key == cache->rootKey; });
+            cache->rootKey = initial.key;
+        }
+        cache->ranking = make_shared<const vector<Word>>(move(ranking));
+    }
+    storeEntropies(initial.key, entropies);
+}
+
+bool Wordle::isWordValid(const string &word) const
+{
+    auto lock = lockWords();
     // if not in wordlist return false
-    if (wordTrie.count(word, allowedID) == 1) return true;
-    return false;
+    int id = wordIndex->id(word);
+    return id != -1 && (*isAllowed)[id];
 }
 
 string Wordle::getPattern(string guess, string target)
@@ -225,8 +650,52 @@ string Wordle::getPattern(string guess, string target)
     return pattern;
 }
 
+/**
+ * @brief pattern as a base 3 number, position i is the i-th digit with
+ * WRONG = 0, MISPLACED = 1, CORRECT = 2
+ */
+int Wordle::getPatternCode(uint32_t guess, uint32_t target)
+{
+    int remaining[26] = { 0 }, tiles[N], code = 0;
+    for (int i = 0; i < N; i++)
+    {
+        int g = WordIndex<N>::letter(guess, i),
+            t = WordIndex<N>::letter(target, i);
+        if (g == t) tiles[i] = 2;
+        else tiles[i] = 0, remaining[t]++;
+    }
+    // misplaced letters are assigned left to right
+    for (int i = 0; i < N; i++)
+    {
+        int g = WordIndex<N>::letter(guess, i);
+        if (tiles[i] != 2 && remaining[g]) tiles[i] = 1, remaining[g]--;
+    }
+    for (int i = N - 1; i >= 0; i--) code = code * 3 + tiles[i];
+    return code;
+}
+
+int Wordle::getPatternCode(const string &pattern)
+{
+    int code = 0;
+    for (int i = N - 1; i >= 0; i--)
+        code = code * 3 + (pattern[i] == TileType::CORRECT     ? 2
+                           : pattern[i] == TileType::MISPLACED ? 1
+                                                               : 0);
+    return code;
+}
+
+string Wordle::getPattern(int code)
+{
+    string pattern(N, TileType::WRONG);
+    for (int i = 0; i < N; i++, code /= 3)
+        if (code % 3 == 2) pattern[i] = TileType::CORRECT;
+        else if (code % 3 == 1) pattern[i] = TileType::MISPLACED;
+    return pattern;
+}
+
 Wordle::Stat Wordle::guess(const string &guess)
 {
+    auto lock = lockWords();
     // return invalid stat
     if (isGameOver())
         return Stat({
@@ -237,28 +706,51 @@ Wordle::Stat Wordle::guess(const string &guess)
             .bits = 0,
             .entropy = 0,
             .remainingBits = 0,
-            .query = wordTrie.query("", allowedID),
+            .query = wordTrie->query("", allowedID),
             .valid = false,
         });
 
-    string pattern = getPattern(guess, targetWord);
+    string pattern = mode == GameMode::ADVERSARIAL
+                         ? getAdversarialPattern(guess)
+                         : getPattern(guess, targetWord);
 
     guesses++;
     auto query = getUpdatedQuery(guess, pattern, getStat(-1).query);
-    int count = getQueryCount(query), prevCount = stats.back().count;
+    auto candidates = getCandidates(query, stats.back().live.get());
+    // the query would also match the words added since the game started
+    int count = isStale(stats.back()) ? ranges::count(*candidates, true)
+                                      : getQueryCount(query),
+        prevCount = stats.back().count;
 
     // Information = log2(1 / P(x)) = - log2(P(x)) = - log2(count / prevCount) = log2(prevCount) - log2(count)
     double bits = log2(prevCount) - log2(count);
 
+    // likely already evaluated when ranking this state
+    auto entropies = getEntropyTable(stats.back().key);
+    int id = wordIndex->id(guess);
+    double entropy = entropies && entropies->contains(id)
+                         ? entropies->at(id).entropy
+                         : getEntropy(-1, guess).entropy;
+
     stats.push_back({
         .guess = guess,
         .pattern = pattern,
         .count = count,
         .patternProb = (double)count / prevCount,
         .bits = bits,
-        .entropy = getEntropy(-1, guess).entropy,
+        .entropy = entropy,
         .remainingBits = log2(count),
         .query = query,
+        .key = getStateKey(*candidates),
+        .candidates = candidates,
+        .live = getLive(&stats.back(), *candidates),
+        // the classes of a game on older words miss the added guesses
+        .classes = isStale(stats.back()) || count > classMaxWords
+                       ? nullptr
+                       : getClasses(stats.back().classes.get(), *candidates),
+        .version = stats.back().version,
+        .parent = stats.back().key,
+        .turn = guesses,
         .valid = true,
     });
 
@@ -270,9 +762,194 @@ Wordle::Stat Wordle::guess(const string &guess)
     return stats.back();
 }
 
+/**
+ * @brief pattern of the largest bucket of the guess in the current state,
+ * ties go to the bucket with the least hints. The target is moved into it
+ */
+string Wordle::getAdversarialPattern(const string &guess)
+{
+    auto &candidates = *stats.back().candidates;
+    uint32_t packed = WordIndex<N>::pack(guess);
+    int counts[243] = { 0 }, first[243];
+    for (int id = 0; id < candidates.size(); id++)
+    {
+        if (!candidates[id]) continue;
+        int code = getPatternCode(packed, wordIndex->packed(id));
+        if (!counts[code]++) first[code] = id;
+    }
+
+    auto hints = [](int code) {
+        int correct = 0, misplaced = 0;
+        for (; code; code /= 3) code % 3 == 2 ? correct++ : misplaced += code % 3;
+        return pair(correct, misplaced);
+    };
+    int worst = -1;
+    for (int code = 0; code < 243; code++)
+        if (counts[code] && (worst == -1 || counts[code] > counts[worst] ||
+                             (counts[code] == counts[worst] &&
+                              hints(code) < hints(worst))))
+            worst = code;
+
+    targetWord = wordIndex->word(first[worst]);
+    return getPattern(worst);
+}
+
 int Wordle::getQueryCount(Trie<N>::Query query) const
 {
-    return wordTrie.count(query);
+    return wordTrie->count(query);
+}
+
+/**
+ * @brief membership of every word id in the words matching the query
+ */
+shared_ptr<const vector<bool>> Wordle::getCandidates(
+    Trie<N>::Query query,
+    const Trie<N>::Live *live) const
+{
+    auto candidates = make_shared<vector<bool>>(wordIndex->size(), false);
+    wordTrie->forEach(
+        query,
+        [&](string_view word) {
+            (*candidates)[wordIndex->id(WordIndex<N>::pack(word))] = true;
+            return true;
+        },
+        live);
+    return candidates;
+}
+
+/**
+ * @brief live counts of the remaining words, the parent's counts minus the
+ * eliminated words. Built from scratch for the initial state
+ */
+shared_ptr<const Trie<Wordle::N>::Live> Wordle::getLive(
+    const Stat *parent,
+    const vector<bool> &candidates) const
+{
+    if (!parent || !parent->live)
+    {
+        auto live = make_shared<Trie<N>::Live>(wordTrie->getLive());
+        for (int id = 0; id < candidates.size(); id++)
+            if (candidates[id]) wordTrie->setLive(wordIndex->word(id), *live, 1);
+        return live;
+    }
+
+    auto live = make_shared<Trie<N>::Live>(*parent->live);
+    auto &remaining = *parent->candidates;
+    for (int id = 0; id < remaining.size(); id++)
+        if (remaining[id] && !candidates[id])
+            wordTrie->setLive(wordIndex->word(id), *live, -1);
+    return live;
+}
+
+/**
+ * @brief Group the allowed guesses by how they split the remaining words. Two
+ * guesses that split a set the same way also split every subset of it the
+ * same way, so the classes of the previous state stay whole and only need to
+ * be merged, by the partition of one guess of each. Partitions are compared by
+ * hash, and checked in full when the hashes match
+ *
+ * @param parent classes of the previous state, null to start from one class
+ * per allowed guess
+ */
+shared_ptr<const Wordle::GuessClasses> Wordle::getClasses(
+    const GuessClasses *parent,
+    const vector<bool> &candidates) const
+{
+    GuessClasses all;
+    if (!parent)
+    {
+        for (int id = 0; id < wordIndex->size(); id++)
+        {
+            if (!(*isAllowed)[id]) continue;
+            all.starts.push_back(all.ids.size());
+            all.ids.push_back(id);
+        }
+        all.starts.push_back(all.ids.size());
+        parent = &all;
+    }
+    vector<uint32_t> words;
+    for (int id = 0; id < candidates.size(); id++)
+        if (candidates[id]) words.push_back(wordIndex->packed(id));
+
+    auto &ids = parent->ids, &starts = parent->starts;
+    int size = starts.size() - 1;
+    auto guess = [&](int c) { return wordIndex->packed(ids[starts[c]]); };
+    vector<uint64_t> hashes(size);
+    parallelFor(size, 1ll * size * words.size(), [&](int c) {
+        hashes[c] = getPartitionHash(guess(c), words);
+    });
+
+    // the previous classes in each class, the partition of a class is only
+    // built once another one has the same hash
+    vector<vector<int>> merged;
+    vector<string> partitions;
+    unordered_multimap<uint64_t, int> byHash;
+    for (int c = 0; c < size; c++)
+    {
+        string partition;
+        int found = -1;
+        for (auto [it, end] = byHash.equal_range(hashes[c]); it != end; it++)
+        {
+            int k = it->second;
+            if (partitions[k].empty())
+                partitions[k] = getPartition(guess(merged[k][0]), words);
+            if (partition.empty()) partition = getPartition(guess(c), words);
+            if (partitions[k] == partition)
+            {
+                found = k;
+                break;
+            }
+        }
+        if (found == -1)
+        {
+            found = merged.size();
+            merged.emplace_back();
+            partitions.push_back(move(partition));
+            byHash.emplace(hashes[c], found);
+        }
+        merged[found].push_back(c);
+    }
+
+    auto classes = make_shared<GuessClasses>();
+    classes->ids.reserve(ids.size());
+    classes->starts.reserve(merged.size() + 1);
+    for (auto &group : merged)
+    {
+        classes->starts.push_back(classes->ids.size());
+        for (int c : group)
+            classes->ids.insert(classes->ids.end(), ids.begin() + starts[c],
+                                ids.begin() + starts[c + 1]);
+    }
+    classes->starts.push_back(classes->ids.size());
+    return classes;
+}
+
+/**
+ * @brief hash of the words matching the query, different guesses that leave
+ * the same words get the same key
+ */
+string Wordle::getStateKey(Trie<N>::Query query) const
+{
+    return getStateKey(*getCandidates(query));
+}
+
+string Wordle::getStateKey(const vector<bool> &candidates) const
+{
+    // FNV-1a over the letters in alphabetical order, words have a fixed
+    // length so no separator is needed
+    uint64_t hash = 14695981039346656037ull;
+    for (int id : wordIndex->getOrder())
+    {
+        if (id >= candidates.size() || !candidates[id]) continue;
+        uint32_t word = wordIndex->packed(id);
+        for (int i = 0; i < N; i++)
+            hash = (hash ^ ('a' + WordIndex<N>::letter(word, i))) *
+                   1099511628211ull;
+    }
+
+    stringstream key;
+    key << hex << setw(16) << setfill('0') << hash;
+    return key.str();
 }
 
 string Wordle::guess2emoji(const string &pattern)
@@ -335,29 +1012,353 @@ Wordle::Stat Wordle::getStat(int i) const
 
 vector<string> Wordle::getWords(int i) const
 {
+    auto lock = lockWords();
     vector<string> result;
-    wordTrie.count(getStat(i).query, &result);
+    result.reserve(getStat(i).count);
+    forEachWord(i, [&result](string_view word) {
+        result.emplace_back(word);
+        return true;
+    });
     return result;
 }
 
-unordered_map<string, int> Wordle::getPatternsCounts(const string &guess,
-                                           Trie<N>::Query query) const
+unordered_map<string, int> Wordle::getPatternsCounts(
+    const string &guess,
+    Trie<N>::Query query,
+    const Trie<N>::Live *live) const
+{
+    auto lock = lockWords();
+    return countPatterns(guess, query, live);
+}
+
+unordered_map<string, int> Wordle::countPatterns(const string &guess,
+                                                 Trie<N>::Query query,
+                                                 const Trie<N>::Live *live) const
 {
-    return wordTrie.getPatternsCounts(guess, query);
+    return wordTrie->getPatternsCounts(guess, query, live);
+}
+
+Wordle::WordsLock::WordsLock(shared_mutex &words, bool exclusive)
+    : exclusive(exclusive)
+{
+    auto held = ranges::find_if(heldWords,
+                                [&](auto &lock) { return lock.first == &words; });
+    if (held != heldWords.end())
+    {
+        // waiting for the readers would wait for this thread, not waiting
+        // would change the words under the calls in progress
+        if (exclusive && !held->second)
+            throw logic_error("the word lists are already held shared");
+        return;
+    }
+    if (exclusive) words.lock();
+    else words.lock_shared();
+    heldWords.push_back({ &words, exclusive });
+    mutex = &words;
+}
+
+Wordle::WordsLock::~WordsLock()
+{
+    if (!mutex) return;
+    erase_if(heldWords, [&](auto &lock) { return lock.first == mutex; });
+    if (exclusive) mutex->unlock();
+    else mutex->unlock_shared();
+}
+
+Wordle::WordsLock Wordle::lockWords(bool exclusive) const
+{
+    return WordsLock(cache->wordsMutex, exclusive);
+}
+
+/**
+ * @brief canonical form of how the guess splits the given words, patterns are
+ * relabeled in order of first appearance so two guesses are equivalent iff
+ * their partitions are equal
+ */
+string Wordle::getPartition(uint32_t guess, const vector<uint32_t> &candidates)
+{
+    int labels[243], count = 0;
+    fill(begin(labels), end(labels), -1);
+    string partition(candidates.size(), 0);
+    for (int i = 0; i < candidates.size(); i++)
+    {
+        int &label = labels[getPatternCode(guess, candidates[i])];
+        if (label == -1) label = count++;
+        partition[i] = label;
+    }
+    return partition;
+}
+
+/**
+ * @brief hash of the partition of getPartition, without building it
+ */
+uint64_t Wordle::getPartitionHash(uint32_t guess,
+                                  const vector<uint32_t> &candidates)
+{
+    int labels[243], count = 0;
+    fill(begin(labels), end(labels), -1);
+    uint64_t hash = 14695981039346656037ull;
+    for (auto &word : candidates)
+    {
+        int &label = labels[getPatternCode(guess, word)];
+        if (label == -1) label = count++;
+        hash = (hash ^ label) * 1099511628211ull;
+    }
+    return hash;
+}
+
+string Wordle::getPartition(int i, const string &guess) const
+{
+    vector<uint32_t> candidates;
+    for (int id : getCandidateIds(getStat(i)))
+        candidates.push_back(wordIndex->packed(id));
+    return getPartition(WordIndex<N>::pack(guess), candidates);
+}
+
+/**
+ * @brief entropies evaluated in the given state, null if there are none
+ */
+shared_ptr<const Wordle::EntropyTable> Wordle::getEntropyTable(
+    const string &key) const
+{
+    shared_lock lock(cache->mutex);
+    auto it = cache->EntropyCache.find(key);
+    if (it == cache->EntropyCache.end()) return nullptr;
+    return it->second;
+}
+
+/**
+ * @brief add entropies to the table of the given state. The table is copied
+ * and replaced so readers holding the previous one are not affected
+ */
+void Wordle::storeEntropies(const string &key, const vector<Word> &words) const
+{
+    if (words.empty()) return;
+    unique_lock lock(cache->mutex);
+    auto &entropies = cache->EntropyCache[key];
+    auto table = entropies ? make_shared<EntropyTable>(*entropies)
+                           : make_shared<EntropyTable>();
+    for (auto &word : words) (*table)[word.id] = word;
+
+    if (entropies) cache->entropyBytes -= getEntryBytes(key, *entropies);
+    else cache->entropyOrder.push_back(key);
+    cache->entropyBytes += getEntryBytes(key, *table);
+    entropies = move(table);
+    evict(*cache);
+}
+
+/**
+ * @brief add or replace the top words of a state, the caller holds the cache
+ * lock
+ */
+void Wordle::storeTopWords(Cache &cache, const string &key, const TopWords &entry)
+{
+    auto [it, inserted] = cache.TopWordsCache.try_emplace(key, entry);
+    if (inserted) cache.topWordsOrder.push_back(key);
+    else
+    {
+        cache.topWordsBytes -= getEntryBytes(key, it->second);
+        it->second = entry;
+    }
+    cache.topWordsBytes += getEntryBytes(key, entry);
+    evict(cache);
+}
+
+/**
+ * @brief drop the oldest entries of the caches over their budget, the caller
+ * holds the cache lock. Evicted states are ranked again when needed, and are
+ * left out of the next snapshot of the cache file
+ */
+void Wordle::evict(Cache &cache)
+{
+    while (cache.topWordsBytes > cache.budget.topWords &&
+           !cache.topWordsOrder.empty())
+    {
+        auto it = cache.TopWordsCache.find(cache.topWordsOrder.front());
+        cache.topWordsBytes -= getEntryBytes(it->first, it->second);
+        cache.TopWordsCache.erase(it);
+        cache.topWordsOrder.pop_front();
+    }
+
+    while (cache.entropyBytes > cache.budget.entropies &&
+           !cache.entropyOrder.empty())
+    {
+        auto key = move(cache.entropyOrder.front());
+        cache.entropyOrder.pop_front();
+        // kept, but no longer a candidate for eviction
+        if (key == cache.rootKey) continue;
+        auto it = cache.EntropyCache.find(key);
+        cache.entropyBytes -= getEntryBytes(key, *it->second);
+        cache.EntropyCache.erase(it);
+    }
+}
+
+size_t Wordle::getEntryBytes(const string &key, const TopWords &entry)
+{
+    // a hash node holds the pair and the next pointer, plus its bucket
+    size_t bytes = sizeof(pair<const string, TopWords>) + 2 * sizeof(void *) +
+                   heapBytes(key) + entry.words.capacity() * sizeof(Word);
+    for (auto &word : entry.words) bytes += heapBytes(word.word);
+    return bytes;
+}
+
+size_t Wordle::getEntryBytes(const string &key, const EntropyTable &table)
+{
+    size_t bytes = sizeof(pair<const string, shared_ptr<const EntropyTable>>) +
+                   2 * sizeof(void *) + heapBytes(key) + sizeof(EntropyTable) +
+                   table.bucket_count() * sizeof(void *);
+    for (auto &[id, word] : table)
+        bytes += sizeof(pair<const int, Word>) + sizeof(void *) + heapBytes(word.word);
+    return bytes;
+}
+
+/**
+ * @brief Estimated memory of every part of the engine
+ */
+vector<Wordle::MemoryUsage> Wordle::getMemoryUsage() const
+{
+    size_t statBytes = stats.capacity() * sizeof(Stat);
+    for (auto &stat : stats)
+    {
+        // shared with the previous game after a reset, counted anyway
+        if (stat.candidates) statBytes += stat.candidates->size() / 8;
+        if (stat.live) statBytes += stat.live->capacity() * sizeof(int);
+        if (stat.classes)
+            statBytes += (stat.classes->ids.capacity() +
+                          stat.classes->starts.capacity()) *
+                         sizeof(int);
+    }
+
+    shared_lock lock(cache->mutex);
+    vector<MemoryUsage> usage = {
+        { "trie", wordTrie->getMemoryUsage(), (size_t)wordTrie->getNodeCount() },
+        { "word index", wordIndex->getMemoryUsage(), (size_t)wordIndex->size() },
+        { "states", statBytes, stats.size() },
+        { "ranking",
+          cache->ranking ? cache->ranking->capacity() * sizeof(Word) : 0,
+          cache->ranking ? cache->ranking->size() : 0 },
+        { "top words cache", cache->topWordsBytes, cache->TopWordsCache.size() },
+        { "entropy cache", cache->entropyBytes, cache->EntropyCache.size() },
+        { "root histograms", cache->rootCounts.capacity() * sizeof(Histogram),
+          cache->rootCounts.size() },
+    };
+    if (sharedCache)
+        usage.push_back({ "shared cache", sharedCache->getSize(),
+                          sharedCache->getCapacity() });
+    return usage;
+}
+
+void Wordle::printMemoryUsage() const
+{
+    size_t total = 0;
+    for (auto &[name, bytes, entries] : getMemoryUsage())
+    {
+        cout << setw(20) << name << ": " << setw(10) << fixed << setprecision(2)
+             << bytes / 1048576.0 << " MiB, " << entries << " entries" << endl;
+        total += bytes;
+    }
+    cout << setw(20) << "total" << ": " << setw(10) << fixed << setprecision(2)
+         << total / 1048576.0 << " MiB" << endl;
+}
+
+Wordle::MemoryBudget Wordle::getMemoryBudget() const
+{
+    shared_lock lock(cache->mutex);
+    return cache->budget;
+}
+
+/**
+ * @brief Cap the caches, evicting right away if they are already over
+ */
+void Wordle::setMemoryBudget(const MemoryBudget &budget)
+{
+    unique_lock lock(cache->mutex);
+    cache->budget = budget;
+    evict(*cache);
+}
+
+/**
+ * @brief Letter counts of the remaining words of a state
+ */
+Wordle::LetterCounts Wordle::getLetterCounts(const Stat &stat) const
+{
+    LetterCounts letters;
+    for (int id : getCandidateIds(stat))
+    {
+        uint32_t word = wordIndex->packed(id);
+        bool seen[26] = {};
+        for (int i = 0; i < N; i++)
+        {
+            int c = WordIndex<N>::letter(word, i);
+            letters.atPos[i][c]++;
+            if (!seen[c]) seen[c] = true, letters.words[c]++;
+        }
+        letters.count++;
+    }
+    return letters;
+}
+
+/**
+ * @brief Upper bound of the entropy of a guess, without looking at the words.
+ * The entropy of a pattern is at most the sum of the entropies of its tiles.
+ * A tile is correct for the words with the letter at that position, and can
+ * only be misplaced for the other words that have the letter. The bound takes
+ * the most uncertain split between misplaced and wrong that allows
+ *
+ * @param guess packed word
+ * @param letters of the remaining words
+ * @return double
+ */
+double Wordle::getEntropyBound(uint32_t guess, const LetterCounts &letters)
+{
+    if (letters.count == 0) return 0;
+    auto h = [](double p) { return p > 0 ? -p * log2(p) : 0; };
+    double bound = 0;
+    for (int i = 0; i < N; i++)
+    {
+        int c = WordIndex<N>::letter(guess, i);
+        double correct = (double)letters.atPos[i][c] / letters.count,
+               present = (double)letters.words[c] / letters.count;
+        double misplaced = min(present - correct, (1 - correct) / 2);
+        bound += h(correct) + h(misplaced) + h(1 - correct - misplaced);
+    }
+    // rounding must not make the bound smaller than the entropy
+    return bound + 1e-9;
+}
+
+double Wordle::getEntropyBound(const Stat &stat, const string &guess) const
+{
+    return getEntropyBound(WordIndex<N>::pack(guess), getLetterCounts(stat));
 }
 
 Wordle::Word Wordle::getEntropy(int i, string guess) const
 {
-    auto stat = getStat(i);
-    auto patterns = getPatternsCounts(guess, stat.query); // expensive
+    return getEntropy(getStat(i), guess);
+}
+
+Wordle::Word Wordle::getEntropy(const Stat &stat, const string &guess) const
+{
+    // the trie no longer has the words removed since the game started
+    if (isStale(stat))
+    {
+        int counts[243] = { 0 };
+        uint32_t packed = WordIndex<N>::pack(guess);
+        for (int id : getCandidateIds(stat))
+            counts[getPatternCode(packed, wordIndex->packed(id))]++;
+        return getEntropy(wordIndex->id(guess), counts);
+    }
+
+    auto patterns = countPatterns(guess, stat.query, stat.live.get()); // expensive
     int total = stat.count;
     // E = sum P(x) * log2(1 / P(x)) where x is the pattern
     // log2(1 / P(x)) = - log2(P(x)) = - log2(count / total) = log2(total) - log2(count)
     double entropy = 0, maxEntropy = log2(patterns.size());
+    int maxBucket = 0;
     for (auto &pattern : patterns)
     {
         double prob = (double)pattern.second / total;
         entropy += prob * (log2(total) - log2(pattern.second));
+        maxBucket = max(maxBucket, pattern.second);
     }
 
     return {
@@ -365,8 +1366,150 @@ Wordle::Word Wordle::getEntropy(int i, string guess) const
         .score = entropy,
         .entropy = entropy,
         .maxEntropy = maxEntropy,
+        .maxBucket = maxBucket,
+        .id = wordIndex->id(guess),
     };
 }
+
+/**
+ * @brief evaluate the words in parallel, in the same order as the ids
+ */
+vector<Wordle::Word> Wordle::getEntropies(const Stat &stat,
+                                          const vector<int> &ids) const
+{
+    vector<Word> words(ids.size());
+    parallelFor(ids.size(), 1ll * ids.size() * stat.count, [&](int i) {
+        words[i] = getEntropy(stat, wordIndex->word(ids[i]));  // expensive
+    });
+    return words;
+}
+
+/**
+ * @brief evaluate the words against the given packed words instead of the
+ * trie, in the same order as the ids
+ */
+vector<Wordle::Word> Wordle::getEntropies(const vector<int> &ids,
+                                          const vector<uint32_t> &words) const
+{
+    vector<Word> result(ids.size());
+    parallelFor(ids.size(), 1ll * ids.size() * words.size(), [&](int i) {
+        int counts[243] = { 0 };
+        uint32_t guess = wordIndex->packed(ids[i]);
+        for (auto &word : words) counts[getPatternCode(guess, word)]++;
+        result[i] = getEntropy(ids[i], counts);
+    });
+    return result;
+}
+
+/**
+ * @brief entropy of the guess from the number of remaining words in each
+ * pattern, indexed by pattern code
+ */
+Wordle::Word Wordle::getEntropy(int id, const int (&counts)[243]) const
+{
+    int total = 0, patterns = 0, maxBucket = 0;
+    for (auto &count : counts) total += count;
+
+    double entropy = 0;
+    for (auto &count : counts)
+    {
+        if (!count) continue;
+        entropy += (double)count / total * (log2(total) - log2(count));
+        patterns++, maxBucket = max(maxBucket, count);
+    }
+    return {
+        .word = wordIndex->word(id),
+        .score = entropy,
+        .entropy = entropy,
+        .maxEntropy = log2(patterns),
+        .maxBucket = maxBucket,
+        .id = id,
+    };
+}
+/**
+ * @brief Words in alphabetical strata of equal size, one word drawn from each.
+ * The seed is fixed so the same words always give the same sample
+ */
+vector<uint32_t> Wordle::getSample(const vector<uint32_t> &words, int size)
+{
+    if (words.size() <= size) return words;
+
+    mt19937 gen(words.size());
+    vector<uint32_t> sample;
+    sample.reserve(size);
+    for (long long i = 0; i < size; i++)
+    {
+        uniform_int_distribution<> dis(i * words.size() / size,
+                                       (i + 1) * words.size() / size - 1);
+        sample.push_back(words[dis(gen)]);
+    }
+    return sample;
+}
+
+/**
+ * @brief Estimate the entropy of guesses from a sample of the count remaining
+ * words, in parallel
+ */
+vector<Wordle::EntropyEstimate> Wordle::estimateEntropies(
+    const vector<int> &ids,
+    const vector<uint32_t> &sample,
+    int count) const
+{
+    vector<EntropyEstimate> estimates(ids.size());
+    parallelFor(ids.size(), 1ll * ids.size() * sample.size(), [&](int i) {
+        estimates[i] = estimateEntropy(wordIndex->packed(ids[i]), sample, count);
+    });
+    return estimates;
+}
+
+/**
+ * @brief Estimate the entropy of a guess from a sample of the count remaining
+ * words. The plug in estimate misses (patterns - 1) / 2m ln 2 bits on average
+ * (Miller-Madow), and its deviation is sqrt(Var(log2 p) / m), shrinking as the
+ * sample covers more of the words. The interval allows twice the bias on top
+ *
+ * @param guess packed word
+ * @param sample packed words
+ * @param count remaining words the sample was drawn from
+ * @return EntropyEstimate
+ */
+Wordle::EntropyEstimate Wordle::estimateEntropy(uint32_t guess,
+                                                const vector<uint32_t> &sample,
+                                                int count)
+{
+    int counts[243] = { 0 }, patterns = 0;
+    for (auto &word : sample) counts[getPatternCode(guess, word)]++;
+
+    double m = sample.size(), entropy = 0, square = 0;
+    for (auto &c : counts)
+    {
+        if (!c) continue;
+        double p = c / m, bits = -log2(p);
+        entropy += p * bits, square += p * bits * bits, patterns++;
+    }
+    // every word is in the sample, nothing to estimate
+    if (m >= count) return { entropy, entropy, entropy };
+
+    double bias = (patterns - 1) / (2 * m * log(2));
+    double deviation =
+        sqrt(max(0.0, square - entropy * entropy) / m * (1 - m / count));
+    return {
+        .entropy = entropy + bias,
+        .low = entropy - sampleDeviations * deviation,
+        .high = entropy + 2 * bias + sampleDeviations * deviation,
+    };
+}
+
+Wordle::EntropyEstimate Wordle::estimateEntropy(const Stat &stat,
+                                                const string &guess,
+                                                int sampleSize) const
+{
+    vector<uint32_t> words;
+    for (int id : getCandidateIds(stat)) words.push_back(wordIndex->packed(id));
+    return estimateEntropy(WordIndex<N>::pack(guess),
+                           getSample(words, sampleSize), stat.count);
+}
+
 void Wordle::Stat::print() const
 {
     if (!valid)
@@ -389,11 +1532,51 @@ void Wordle::Stat::print() const
          << fixed << setprecision(2) << remainingBits << " bits" << endl;
 }
 
-vector<Wordle::Word> Wordle::getTopNWords(const int n, bool showProgress)
+vector<Wordle::Word> Wordle::getTopNWords(const int n,
+                                          bool showProgress) const
+{
+    return getTopNWords(n, getStat(-1), showProgress);
+}
+
+/**
+ * @brief Rank the best n guesses in the given state. Does not modify the
+ * engine apart from the caches, so it can be called concurrently
+ */
+vector<Wordle::Word> Wordle::getTopNWords(const int n,
+                                          const Stat &stat,
+                                          bool showProgress) const
+{
+    bool exact;
+    return rankTopNWords(n, stat, showProgress,
+                         chrono::steady_clock::time_point::max(), {}, exact);
+}
+
+/**
+ * @brief Rank the best n guesses, but give up at the deadline or when a stop
+ * is requested. Guesses are evaluated best bound first, so the words found
+ * by then are the best of those that were evaluated. Only complete rankings
+ * are cached
+ *
+ * @param exact set to false if the ranking stopped early
+ */
+vector<Wordle::Word> Wordle::getTopNWords(const int n,
+                                          const Stat &stat,
+                                          chrono::steady_clock::time_point deadline,
+                                          stop_token stop,
+                                          bool &exact) const
+{
+    return rankTopNWords(n, stat, false, deadline, stop, exact);
+}
+
+vector<Wordle::Word> Wordle::rankTopNWords(const int n,
+                                           const Stat &stat,
+                                           bool showProgress,
+                                           chrono::steady_clock::time_point deadline,
+                                           stop_token stop,
+                                           bool &exact) const
 {
-    // we assume it is sorted
-    // we first calculate for uninitialized words
-    // when recalculating
+    auto lock = lockWords();
+    // the ranking is sorted by the entropy bounds of the initial state
     // we know that entropy can never be more than the previous entropy,
     // therefore best case senario new=prev
     // So we can skip when we have n elements, and the smallest element is >= next elements old entropy
@@ -403,95 +1586,466 @@ vector<Wordle::Word> Wordle::getTopNWords(const int n, bool showProgress)
     // among all the patterns.
     // since number of words can only decrease, max entropy can only decrease also.
     // max entropy is just log2(number of patterns)
-    ProgressBar progressBar(wordlist.size());
+    // the state we came from has tighter bounds for the words it evaluated
+    exact = true;
+    if (n == 0) return {};
+    ProgressBar progressBar(cache->ranking->size());
     if (showProgress) progressBar.update(0);
 
-    auto query = getStat(-1).query;
+    // in large states guesses are estimated from a sample of the remaining
+    // words before they are evaluated. n guesses are likely worth atleast the
+    // nth largest lower end, a guess whose interval ends below it is skipped.
+    // equivalent guesses have the same estimate, so lower ends are only
+    // counted once. the others are evaluated on the packed words
+    bool adversarial = mode == GameMode::ADVERSARIAL;
+    bool sampled = entropyMode == EntropyMode::SAMPLED && !adversarial &&
+                   stat.count >= 4 * sampleSize;
 
-    // check if result exists in cache
-    if (cache.TopWordsCache.contains(query.serialize()))
+    // adversarial and sampled rankings are cached separately
+    string key = adversarial ? stat.key + adversarialSuffix
+                 : sampled   ? stat.key + sampledSuffix
+                             : stat.key;
+
+    // check if result exists in cache, an exact ranking also serves a
+    // sampled one
     {
-        auto &result = cache.TopWordsCache[query.serialize()];
-        if (result.n >= n || result.words.size() < result.n)
+        shared_lock lock(cache->mutex);
+        for (auto &cached : sampled ? vector{ stat.key, key } : vector{ key })
         {
+            auto it = cache->TopWordsCache.find(cached);
+            if (it == cache->TopWordsCache.end() ||
+                (it->second.n < n && it->second.words.size() >= it->second.n))
+                continue;
+            auto result = it->second.words;
+            lock.unlock();
             if (showProgress)
             {
                 progressBar.finish();
                 cout << "cache hit!" << endl;
             }
-            return result.words;
+            return result;
         }
     }
 
-    auto comp = [&query, this](const Word &a, const Word &b) {
-        if (!feq(a.score, b.score)) return a.score > b.score;
-        if (isInWordSpace(a.word, query)) return true;
-        return false;
+    // another process might have ranked this state already
+    int sharedN;
+    vector<SharedCache::Record> records;
+    // any process of the user can write the segment, only trust known guesses
+    auto isKnown = [this](const SharedCache::Record &record) {
+        return record.id >= 0 && record.id < wordIndex->size() &&
+               (*isAllowed)[record.id];
+    };
+    if (sharedCache && sharedCache->find(key, sharedN, records) &&
+        (sharedN >= n || records.size() < sharedN) &&
+        ranges::all_of(records, isKnown))
+    {
+        vector<Word> result;
+        for (auto &record : records)
+            result.push_back({
+                .word = wordIndex->word(record.id),
+                .score = record.score,
+                .entropy = record.entropy,
+                .maxEntropy = record.maxEntropy,
+                .maxBucket = record.maxBucket,
+                .id = record.id,
+            });
+        TopWords entry = {
+            .n = sharedN,
+            .words = result,
+        };
+        {
+            unique_lock lock(cache->mutex);
+            storeTopWords(*cache, key, entry);
+        }
+        if (cacheLog) cacheLog->append(serializeEntry(key, entry));
+        if (showProgress)
+        {
+            progressBar.finish();
+            cout << "shared cache hit!" << endl;
+        }
+        return result;
+    }
+
+    // best first, fully ordered so that the worst word can be dropped. scores
+    // are compared on a grid, feq is not transitive.
+    // the adversary always answers with the largest bucket, so that decides
+    // first and entropy breaks ties
+    auto inWordSpace = [this, &stat](int id) { return isInWordSpace(id, stat); };
+    auto comp = [inWordSpace, adversarial](const Word &a, const Word &b) {
+        if (adversarial && a.maxBucket != b.maxBucket)
+            return a.maxBucket < b.maxBucket;
+        if (scoreKey(a.score) != scoreKey(b.score))
+            return scoreKey(a.score) > scoreKey(b.score);
+        if (inWordSpace(a.id) != inWordSpace(b.id)) return inWordSpace(a.id);
+        return a.word < b.word;
+    };
+
+    // guesses that split the remaining words the same way are equivalent,
+    // only one guess per class is evaluated and ranked, preferring one that
+    // can be the answer. in a state without classes every guess is its own
+    auto classes = stat.classes && !isStale(stat) ? stat.classes : nullptr;
+    vector<bool> representative(wordIndex->size(), !classes);
+    for (int c = 0; classes && c + 1 < classes->starts.size(); c++)
+    {
+        auto first = classes->ids.begin() + classes->starts[c],
+             last = classes->ids.begin() + classes->starts[c + 1];
+        // the lowest id, so that every path to the state ranks the same guess
+        int best = *min_element(first, last, [&](int a, int b) {
+            return pair(!inWordSpace(a), a) < pair(!inWordSpace(b), b);
+        });
+        representative[best] = true;
+    }
+
+    set<Word, decltype(comp)> topWords(comp);
+    auto rank = [&](const Word &word) {
+        topWords.insert(word);
+        if (topWords.size() > n) topWords.erase(prev(topWords.end()));
+    };
+
+    // can a word with the given max entropy still make it into the top n?
+    // [equal because we need to rank words in search space higher]
+    // at most 2^maxEntropy patterns, so the largest bucket is at least
+    // count / 2^maxEntropy
+    // an entropy of at most e also means the largest bucket holds atleast
+    // count / 2^e words
+    auto canRank = [&](double maxEntropy, double entropy = INFINITY) {
+        if (topWords.size() < n) return true;
+        auto &top = *prev(topWords.end());
+        if (!adversarial) return min(maxEntropy, entropy) >= top.entropy;
+        double patterns = min(round(exp2(maxEntropy)), exp2(entropy));
+        return ceil(stat.count / patterns - 1e-9) <= top.maxBucket;
+    };
+    // there are never more patterns than remaining words
+    double patternBound = log2(min(243, max(stat.count, 1)));
+    // a game started before the words changed can hold words the initial
+    // state no longer has, its bounds do not hold there
+    auto rankingBound = [&, stale = isStale(stat)](const Word &ranked) {
+        return stale ? patternBound : min(ranked.maxEntropy, patternBound);
+    };
+
+    // cheap bound from the letters of the remaining words, lets words that
+    // were never evaluated be skipped too
+    auto letters = getLetterCounts(stat);
+    auto canScore = [&](const Word &ranked) {
+        return canRank(patternBound,
+                       getEntropyBound(wordIndex->packed(ranked.id), letters));
+    };
+
+    auto entropies = getEntropyTable(stat.key),
+         bounds = getEntropyTable(stat.parent);
+    // tables seeded from the cache file do not know the largest bucket
+    auto evaluated = [&](int id) {
+        return entropies && entropies->contains(id) &&
+               (!adversarial || entropies->at(id).maxBucket);
+    };
+    vector<uint32_t> remaining, sample;
+    if (sampled)
+    {
+        for (int id : getCandidateIds(stat))
+            remaining.push_back(wordIndex->packed(id));
+        sample = getSample(remaining, sampleSize);
+    }
+    set<double> lows;
+    auto cutoff = [&] { return lows.size() < n ? -INFINITY : *lows.begin(); };
+
+    auto needsEntropy = [&](const Word &ranked) {
+        return !evaluated(ranked.id) &&
+               (!bounds || !bounds->contains(ranked.id) ||
+                canRank(bounds->at(ranked.id).maxEntropy)) &&
+               canScore(ranked);
     };
 
-    priority_queue<Word, vector<Word>, decltype(comp)> topWords(comp);
+    // words are evaluated in parallel a block at a time. the top n only gets
+    // better within a block, so this evaluates every word the serial loop
+    // would, and possibly a few more. a limited ranking checks its limits
+    // between blocks, so they are smaller. an evaluator can give up the
+    // ranking until a block is evaluated, it is ranked again from the start
+    // then, so its blocks are larger
+    bool limited =
+        deadline != chrono::steady_clock::time_point::max() || stop.stop_possible();
+    auto stopped = [&] {
+        return stop.stop_requested() || chrono::steady_clock::now() >= deadline;
+    };
+    const int blockSize = limited ? 64 : evaluator ? 2048 : 512;
+    unordered_map<int, Word> block;
     vector<Word> updatedWords;
-    for (int i = 0; !wordlist.empty(); i++)
-    {
-        // either -1 (uninitialized) or not enough words
-        // or the smallest updated entropy in top n (topEntropy)
-        // is leq the next word's max entropy (wordlist)
-        // [meaning we can possibly get a better or equal entropy]
-        // [equal because we need to rank words in search space higher]
-        if (feq(wordlist.top().maxEntropy, -1) ||
-            (n != 0 && (topWords.size() < n ||
-                        wordlist.top().maxEntropy >= topWords.top().entropy)))
+    for (int i = 0; i < cache->ranking->size(); i++)
+    {
+        auto &ranked = (*cache->ranking)[i];
+        // the ranking is sorted, nothing after this can make it either
+        if (!canRank(rankingBound(ranked))) break;
+
+        if (i % blockSize == 0)
         {
-            auto word = wordlist.top();
-            wordlist.pop();
-            word = getEntropy(-1, word.word);  // expensive
-            if (feq(word.maxEntropy, 0) && !isInWordSpace(word.word, query))
-                continue;
-            topWords.push(word);
-            if (topWords.size() > n) topWords.pop();
-            updatedWords.push_back(word);
-        }
-        else break;
+            vector<int> ids;
+            for (int j = i; j < min<int>(i + blockSize, cache->ranking->size()) &&
+                            canRank(rankingBound((*cache->ranking)[j]));
+                 j++)
+                if (representative[(*cache->ranking)[j].id] &&
+                    needsEntropy((*cache->ranking)[j]))
+                    ids.push_back((*cache->ranking)[j].id);
+            // once stopped, only words evaluated before are still ranked
+            if (!exact || (limited && !ids.empty() && stopped()))
+            {
+                exact = false;
+                ids.clear();
+            }
+            if (sampled)
+            {
+                auto estimates = estimateEntropies(ids, sample, stat.count);
+                for (auto &estimate : estimates)
+                {
+                    lows.insert(estimate.low);
+                    if (lows.size() > n) lows.erase(lows.begin());
+                }
+                vector<int> kept;
+                for (int k = 0; k < ids.size(); k++)
+                    if (estimates[k].high >= cutoff()) kept.push_back(ids[k]);
+                ids.swap(kept);
+            }
 
+            block.clear();
+            if (!ids.empty())
+                for (auto &word : evaluator ? evaluator(stat, ids)
+                                  : sampled ? getEntropies(ids, remaining)
+                                            : getEntropies(stat, ids))
+                {
+                    block[word.id] = word;
+                    updatedWords.push_back(word);
+                }
+        }
         if (showProgress) progressBar.update(i + 1);
+        if (!representative[ranked.id]) continue;
+
+        Word word;
+        if (evaluated(ranked.id)) word = entropies->at(ranked.id);
+        else if (!needsEntropy(ranked)) continue;
+        // ruled out by its estimate
+        else if (!block.contains(ranked.id)) continue;
+        else word = block.at(ranked.id);
+
+        if (feq(word.maxEntropy, 0) && !inWordSpace(word.id))
+            continue;
+        rank(word);
     }
 
-    for (auto &word : updatedWords) wordlist.push(word);
+    // the words evaluated before a stop are still exact
+    storeEntropies(stat.key, updatedWords);
 
-    vector<Word> result;
-    result.reserve(n);
-    while (!topWords.empty())
+    vector<Word> result(topWords.begin(), topWords.end());
+    if (!exact)
     {
-        result.push_back(topWords.top());
-        topWords.pop();
+        if (showProgress) progressBar.finish();
+        return result;
+    }
+    TopWords entry = {
+        .n = n,
+        .words = result,
+    };
+    {
+        unique_lock lock(cache->mutex);
+        storeTopWords(*cache, key, entry);
+    }
+    // persisted in the background
+    if (cacheLog) cacheLog->append(serializeEntry(key, entry));
+    if (sharedCache)
+    {
+        records.clear();
+        for (auto &word : result)
+            records.push_back({
+                .id = word.id,
+                .maxBucket = word.maxBucket,
+                .score = word.score,
+                .entropy = word.entropy,
+                .maxEntropy = word.maxEntropy,
+            });
+        sharedCache->store(key, n, records);
     }
-    reverse(result.begin(), result.end());
-
-    if (n != 0)
-        cache.TopWordsCache[query.serialize()] = {
-            .n = n,
-            .words = result,
-        };
 
     if (showProgress) progressBar.finish();
     return result;
 }
 
-bool Wordle::isInWordSpace(const string &word, Trie<N>::Query &query) const
+/**
+ * @brief fewest guesses that force a win against an adversary that picks the
+ * pattern after every guess, at most depth guesses
+ *
+ * @param guesses allowed guesses, packed
+ * @param candidates words still consistent with the patterns, packed
+ * @param bound only results below the bound matter, anything else is returned
+ * as the bound
+ * @return int
+ */
+int Wordle::minimax(const vector<uint32_t> &guesses,
+                    const vector<uint32_t> &candidates,
+                    int depth,
+                    int bound)
 {
-    // if it exists in the possible words and it matches the query
-    return wordTrie.count(word, possibleID) && query.verify(word);
+    const int allCorrect = 242;
+    bound = min(bound, depth + 1);
+    if (candidates.size() == 1) return min(1, bound);
+    // two words need at least two guesses
+    if (bound <= 2) return bound;
+    if (bound == 3)
+    {
+        // only a guess that tells every word apart is good enough, most
+        // guesses are ruled out after a few words
+        for (auto &guess : guesses)
+        {
+            bitset<243> seen;
+            bool distinct = true;
+            for (int j = 0; j < candidates.size() && distinct; j++)
+            {
+                int code = getPatternCode(guess, candidates[j]);
+                distinct = !seen[code];
+                seen[code] = true;
+            }
+            if (distinct) return 2;
+        }
+        return bound;
+    }
+
+    // try the guesses with the smallest worst case first, they tighten the
+    // bound fastest
+    vector<pair<int, int>> order;  // largest bucket, guess
+    for (int i = 0; i < guesses.size(); i++)
+    {
+        int counts[243] = { 0 }, maxBucket = 0;
+        for (auto &word : candidates)
+            maxBucket = max(maxBucket, ++counts[getPatternCode(guesses[i], word)]);
+        // guesses that do not split the words get nowhere
+        if (maxBucket < candidates.size() || counts[allCorrect])
+            order.push_back({ maxBucket, i });
+    }
+    sort(order.begin(), order.end());
+
+    for (auto &[maxBucket, i] : order)
+    {
+        bound = min(bound, minimax(guesses, candidates, guesses[i], depth, bound));
+        if (bound <= 2) break;
+    }
+    return bound;
+}
+
+/**
+ * @brief guesses needed to force a win starting with the given guess, anything
+ * not below the bound is returned as is
+ */
+int Wordle::minimax(const vector<uint32_t> &guesses,
+                    const vector<uint32_t> &candidates,
+                    uint32_t guess,
+                    int depth,
+                    int bound)
+{
+    const int allCorrect = 242;
+    vector<vector<uint32_t>> buckets(243);
+    for (auto &word : candidates)
+        buckets[getPatternCode(guess, word)].push_back(word);
+    buckets[allCorrect].clear();
+    // the largest bucket is the most likely to exceed the bound
+    sort(buckets.begin(), buckets.end(),
+         [](auto &a, auto &b) { return a.size() > b.size(); });
+
+    int worst = 1;
+    for (auto &bucket : buckets)
+    {
+        if (bucket.empty() || worst >= bound) break;
+        worst = max(worst, 1 + minimax(guesses, bucket, depth - 1, bound - 1));
+    }
+    return worst;
+}
+
+/**
+ * @brief best guess against an adversary in the given state, searching at most
+ * depth guesses ahead. Meant for the end game, the search is exponential
+ */
+Wordle::Strategy Wordle::solveAdversarial(const Stat &stat, int depth) const
+{
+    vector<uint32_t> candidates, guesses;
+    for (int id = 0; id < wordIndex->size(); id++)
+    {
+        if (isInWordSpace(id, stat)) candidates.push_back(wordIndex->packed(id));
+        if ((*isAllowed)[id]) guesses.push_back(wordIndex->packed(id));
+    }
+    if (candidates.empty() || depth <= 0) return { .guess = "", .guesses = -1 };
+    if (candidates.size() == 1)
+        return { .guess = WordIndex<N>::unpack(candidates[0]), .guesses = 1 };
+
+    // equivalent guesses lead to the same game, only one per partition
+    // is searched, preferring one that can be the answer
+    vector<tuple<int, bool, uint32_t>> order;  // largest bucket, !candidate, guess
+    unordered_set<string> partitions;
+    for (auto &guess : guesses)
+    {
+        string partition = getPartition(guess, candidates);
+        int maxBucket = 0, counts[243] = { 0 };
+        for (auto &label : partition)
+            maxBucket = max(maxBucket, ++counts[(int)label]);
+        bool candidate = isInWordSpace(wordIndex->id(guess), stat);
+        order.push_back({ maxBucket, !candidate, guess });
+    }
+    sort(order.begin(), order.end());
+    erase_if(order, [&](auto &entry) {
+        return !partitions.insert(getPartition(get<2>(entry), candidates)).second;
+    });
+
+    // the guesses are searched in parallel, ties go to the earliest guess in
+    // the order so the result does not depend on the scheduling
+    mutex bestMutex;
+    int best = depth + 1, bestIdx = -1;
+    // every guess splits the candidates, and below it every guess again
+    long long work = 1ll * order.size() * guesses.size() * candidates.size();
+    parallelFor(order.size(), work, [&](int i) {
+        int bound;
+        {
+            lock_guard lock(bestMutex);
+            bound = best + 1;
+        }
+        int worst = minimax(guesses, candidates, get<2>(order[i]), depth, bound);
+
+        lock_guard lock(bestMutex);
+        if (worst < best || (worst == best && i < bestIdx))
+            best = worst, bestIdx = i;
+    });
+
+    if (best > depth) return { .guess = "", .guesses = -1 };
+    return { .guess = WordIndex<N>::unpack(get<2>(order[bestIdx])),
+             .guesses = best };
+}
+
+/**
+ * @brief every word evaluated in the initial state, best max entropy first
+ */
+shared_ptr<const vector<Wordle::Word>> Wordle::getRanking() const
+{
+    shared_lock lock(cache->mutex);
+    return cache->ranking;
+}
+
+bool Wordle::isInWordSpace(const string &word, const Stat &stat) const
+{
+    return isInWordSpace(wordIndex->id(word), stat);
+}
+
+bool Wordle::isInWordSpace(int id, const Stat &stat) const
+{
+    // if it exists in the possible words and it matches the query. states
+    // from before words were added do not know their ids
+    return id != -1 && stat.candidates && id < stat.candidates->size() &&
+           (*stat.candidates)[id];
 }
 
 void Wordle::printPossibleWords() const
 {
-    vector<string> result = getWords(-1);
     cout << setw(titleWidth) << "POSSIBILITIES: " << "{ ";
-    for (auto &word : result) cout << '"' << word << "\", ";
+    forEachWord(-1, [](string_view word) {
+        cout << '"' << word << "\", ";
+        return true;
+    });
     cout << "}" << endl;
 }
 
-void Wordle::printTopNWords(int n)
+void Wordle::printTopNWords(int n) const
 {
     cout << "Calculating top " << n << " words..." << endl;
     auto topWords = getTopNWords(n, true);
@@ -510,22 +2064,32 @@ void Wordle::printTopNWords(int n)
 
 void Wordle::setRandomTargetWord()
 {
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dis(1, wordTrie.count("", possibleID));
-    targetWord = wordTrie.getNthWord(dis(gen), possibleID);
+    targetWord = getRandomWord();
+}
+
+string Wordle::getRandomWord()
+{
+    auto lock = lockWords();
+    uniform_int_distribution<> dis(1, wordTrie->count("", possibleID));
+    return wordTrie->getNthWord(dis(random), possibleID);
 }
 
 void Wordle::reset()
 {
+    auto lock = lockWords();
     guesses = 0;
     status = GameStatus::ONGOING;
-    wordlist = cache.wordlistCache;
-    auto stat = getStat(0);
+    // the next game plays on the current words
+    auto stat = isStale(stats[0]) ? getInitialStat() : getStat(0);
     stats.clear();
     stats.push_back(stat);
 }
 
+shared_ptr<Wordle> Wordle::clone() const
+{
+    return make_shared<Wordle>(*this);
+}
+
 bool Wordle::Word::operator<(const Word &other) const
 {
     if (feq(maxEntropy, other.maxEntropy)) return entropy < other.entropy;
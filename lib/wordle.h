@@ -1,17 +1,36 @@
 #pragma once
 
+#include <chrono>
 #include <cmath>
-#include <queue>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <shared_mutex>
+#include <stop_token>
 #include <string>
 #include <vector>
 #include "trie.h"
+#include "wordIndex.h"
 
 using namespace std;
 
+class CacheLog;
+class SharedCache;
+
 inline bool feq(double a, double b)
 {
     return fabs(a - b) < 1e-6;
 }
+// score on a fixed grid, coarse enough to hide rounding errors. unlike feq,
+// comparing it is transitive, so it can order containers and sorts
+inline long long scoreKey(double score)
+{
+    return llround(score * 1e6);
+}
 class Wordle {
    public:
     enum TileType {
@@ -26,23 +45,108 @@ class Wordle {
         WON,
         LOST,
     };
+
+    // in adversarial games the host answers with the largest pattern bucket
+    enum class GameMode {
+        NORMAL,
+        ADVERSARIAL,
+    };
+    // how guesses are evaluated when ranking large states
+    enum class EntropyMode {
+        EXACT,
+        // estimated from a sample of the remaining words first, only the
+        // guesses whose interval reaches the top n are evaluated exactly. the
+        // top words are only probably exact, a guess whose entropy falls
+        // outside its interval of 4 deviations can be ruled out wrongly, so
+        // these rankings are cached apart from exact ones
+        SAMPLED,
+    };
+
+    // entropy of a guess estimated from a sample, with a confidence interval
+    struct EntropyEstimate {
+        double entropy;
+        double low;
+        double high;
+    };
     struct Word {
         string word;
         double score;
         double entropy;
         double maxEntropy;
+        // size of the largest pattern bucket, 0 if unknown
+        int maxBucket = 0;
+        int id = -1;
 
         bool operator<(const Word &other) const;
     };
 
+    struct Strategy {
+        string guess;
+        // guesses needed to force a win, -1 if not possible within the depth
+        int guesses;
+    };
+
+    // estimated bytes held by one part of the engine
+    struct MemoryUsage {
+        string name;
+        size_t bytes;
+        size_t entries;
+    };
+
+    // caps in bytes, a cache over its budget evicts its oldest entries
+    struct MemoryBudget {
+        size_t topWords = SIZE_MAX;
+        size_t entropies = SIZE_MAX;
+        // pattern table of WordleLoop, patterns are computed when needed
+        // instead if the table does not fit
+        size_t patterns = SIZE_MAX;
+    };
+
    protected:
     static const size_t N = 5;
 
     virtual Trie<N>::Query getUpdatedQuery(const string &guess,
                                            const string &pattern,
                                            Trie<N>::Query query);
+    // called by updateWords with the ids that became possible and the ids
+    // that no longer are
+    virtual void updatePossibleWords(const vector<int> &added,
+                                     const vector<int> &removed)
+    {}
+    // pattern counts of the guess, getPatternsCounts without the lock
+    virtual unordered_map<string, int> countPatterns(
+        const string &guess,
+        Trie<N>::Query query,
+        const Trie<N>::Live *live) const;
+
+   public:
+    // holds the lock of the word lists for one call, shared by the calls that
+    // read them and exclusive in updateWords. a thread that already holds it
+    // does not lock it again, a writer waiting in between would block it. a
+    // thread holding it shared cannot take it exclusive, that throws. code
+    // outside the engine reading getWordIndex or getRanking holds it shared
+    class WordsLock {
+       public:
+        WordsLock(shared_mutex &mutex, bool exclusive);
+        WordsLock(const WordsLock &) = delete;
+        WordsLock &operator=(const WordsLock &) = delete;
+        ~WordsLock();
+
+       private:
+        shared_mutex *mutex = nullptr;
+        bool exclusive;
+    };
+    WordsLock lockWords(bool exclusive = false) const;
+
+    // allowed guesses grouped by how they split the remaining words of a
+    // state, the guesses of a class are equivalent there
+    struct GuessClasses {
+        // guess ids, class after class
+        vector<int> ids;
+        // where each class starts in ids, then the end of the last one
+        vector<int> starts;
+    };
 
-   private:
     struct Stat {
         string guess;
         string pattern;
@@ -52,12 +156,31 @@ class Wordle {
         double entropy;
         double remainingBits;
         Trie<N>::Query query;
+        // identifies the remaining words, independent of the guesses made
+        string key;
+        // remaining words by id, built once per state
+        shared_ptr<const vector<bool>> candidates;
+        // remaining words below every trie node, traversals skip dead subtrees
+        shared_ptr<const Trie<N>::Live> live;
+        // merged from the classes of the state this one was reached from.
+        // null if more than a few words remain, every guess is a class of its
+        // own then, and in games started before the words changed
+        shared_ptr<const GuessClasses> classes;
+        // trie version the game started on, see updateWords
+        int version = 0;
+        // key of the state this one was reached from
+        string parent;
+        int turn;
         bool valid = false;
 
         void print() const;
     };
 
-   public:
+    // evaluates the ids in the state, in the same order as the ids. it may
+    // throw to give up the ranking, nothing is cached then
+    typedef function<vector<Word>(const Stat &, const vector<int> &)> Evaluator;
+
+    // copies share the word lists and caches, each copy plays its own game
     Wordle(const string &allowedFilepath,
            const string &possibleFilepath,
            const string &cacheFilepath = "");
@@ -68,54 +191,246 @@ class Wordle {
            const string &cacheFilepath);
 
     // Methods
-    bool isWordValid(const string &w);
+    bool isWordValid(const string &w) const;
     Stat guess(const string &guess);
     static string guess2emoji(const string &result);
     bool isGameOver() const { return status != GameStatus::ONGOING; }
     void printPossibleWords() const;
-    void printTopNWords(int n);
+    void printTopNWords(int n) const;
+    void printMemoryUsage() const;
     virtual void reset();
+    // a copy of the same type, see the copy constructor
+    virtual shared_ptr<Wordle> clone() const;
     bool loadCache();
     bool saveCache() const;
-    bool isInWordSpace(const string &word, Trie<N>::Query &query) const;
+    bool openSharedCache(const string &name, size_t capacity = 1 << 14);
+    int updateWords(const vector<string> &added,
+                    const vector<string> &removed,
+                    bool possible = true);
+    bool isInWordSpace(const string &word, const Stat &stat) const;
+    bool isInWordSpace(int id, const Stat &stat) const;
+    Strategy solveAdversarial(const Stat &stat, int depth) const;
 
     // Getters
     static string getPattern(string guess, string target);
+    static int getPatternCode(uint32_t guess, uint32_t target);
+    static int getPatternCode(const string &pattern);
+    static string getPattern(int code);
     int getGuesses() const { return guesses; }
-    int getMaxGuesses() const { return maxGuesses; }
+    static int getMaxGuesses() { return maxGuesses; }
     Stat getStat(int i) const;
     string getTargetWord() const { return targetWord; }
     GameStatus getStatus() const { return status; }
+    GameMode getGameMode() const { return mode; }
+    EntropyMode getEntropyMode() const { return entropyMode; }
     vector<string> getWords(int i) const;
-    virtual unordered_map<string, int> getPatternsCounts(const string &guess,
-                                               Trie<N>::Query query) const;
+    template <typename Visitor>
+    int forEachWord(int i, Visitor &&visit) const;
+    auto getCandidateIds(const Stat &stat) const;
+    unordered_map<string, int> getPatternsCounts(
+        const string &guess,
+        Trie<N>::Query query,
+        const Trie<N>::Live *live = nullptr) const;
     Word getEntropy(int i, string guess) const;
-    virtual vector<Word> getTopNWords(const int n, bool showProgress = false);
+    Word getEntropy(const Stat &stat, const string &guess) const;
+    Word getEntropy(int id, const int (&counts)[243]) const;
+    double getEntropyBound(const Stat &stat, const string &guess) const;
+    EntropyEstimate estimateEntropy(const Stat &stat,
+                                    const string &guess,
+                                    int sampleSize) const;
+    string getPartition(int i, const string &guess) const;
+    static string getPartition(uint32_t guess,
+                               const vector<uint32_t> &candidates);
+    static uint64_t getPartitionHash(uint32_t guess,
+                                     const vector<uint32_t> &candidates);
+    vector<Word> getTopNWords(const int n, bool showProgress = false) const;
+    virtual vector<Word> getTopNWords(const int n,
+                                      const Stat &stat,
+                                      bool showProgress = false) const;
+    virtual vector<Word> getTopNWords(const int n,
+                                      const Stat &stat,
+                                      chrono::steady_clock::time_point deadline,
+                                      stop_token stop,
+                                      bool &exact) const;
     virtual int getQueryCount(Trie<N>::Query query) const;
+    string getStateKey(Trie<N>::Query query) const;
+    const WordIndex<N> &getWordIndex() const { return *wordIndex; }
+    shared_ptr<const vector<Word>> getRanking() const;
+    virtual vector<MemoryUsage> getMemoryUsage() const;
+    MemoryBudget getMemoryBudget() const;
 
     // Setters
     void setTargetWord(const string &word) { targetWord = word; }
     void setRandomTargetWord();
+    // a possible word drawn from the generator of the targets
+    string getRandomWord();
+    // random targets are drawn from a generator seeded from the system,
+    // seeding it makes them reproducible
+    void setSeed(uint64_t seed) { random.seed(seed); }
+    void setGameMode(GameMode m) { mode = m; }
+    void setEntropyMode(EntropyMode m, int sampleSize = 256)
+    {
+        entropyMode = m, this->sampleSize = sampleSize;
+    }
+    virtual void setMemoryBudget(const MemoryBudget &budget);
+    // replaces the engine's own evaluation when ranking, empty to restore it
+    void setEvaluator(Evaluator e) { evaluator = move(e); }
 
    private:
     struct TopWords {
         int n;
         vector<Word> words;
     };
+    typedef unordered_map<int, Word> EntropyTable;  // by word id
+    // pattern counts of a guess in the initial state, by pattern code, with
+    // the sums its entropy is made of so that a few counts can change cheaply
+    struct Histogram {
+        bool built = false;
+        int counts[243];
+        int patterns, maxBucket;
+        // sum of count * log2(count)
+        double weighted;
+    };
     struct Cache {
-        priority_queue<Word> wordlistCache;
+        // every word evaluated in the initial state, best max entropy first.
+        // never modified once built, so games and calls share it
+        shared_ptr<const vector<Word>> ranking;
+        // keyed by Stat::key, tables are replaced instead of modified
         unordered_map<string, TopWords> TopWordsCache;
+        unordered_map<string, shared_ptr<const EntropyTable>> EntropyCache;
         string cachePath;
+
+        MemoryBudget budget;
+        // estimated size of the caches, keys in the order they were added
+        size_t topWordsBytes = 0, entropyBytes = 0;
+        deque<string> topWordsOrder, entropyOrder;
+        // the initial state's entropies bound every first ranking, never evicted
+        string rootKey;
+        // of every allowed word by id, built on the first update of the words
+        // so that later updates only count the words that changed
+        vector<Histogram> rootCounts;
+        mutable shared_mutex mutex;
+        // guards the trie, the word index and the word flags, which every
+        // copy shares and updateWords changes. taken before mutex
+        mutable shared_mutex wordsMutex;
+        // updateWords changed them since the cache file was loaded
+        bool wordsChanged = false;
+    };
+
+    // letters of the remaining words, enough to bound the entropy of a guess
+    struct LetterCounts {
+        int count = 0;
+        // words with the letter at the position
+        int atPos[N][26] = {};
+        // words with the letter anywhere
+        int words[26] = {};
     };
 
+    vector<Word> rankTopNWords(const int n,
+                               const Stat &stat,
+                               bool showProgress,
+                               chrono::steady_clock::time_point deadline,
+                               stop_token stop,
+                               bool &exact) const;
+    LetterCounts getLetterCounts(const Stat &stat) const;
+    Stat getInitialStat() const;
+    bool isStale(const Stat &stat) const;
+    void updateRanking(const vector<int> &addedPossible,
+                       const vector<int> &removedPossible,
+                       const vector<int> &addedAllowed,
+                       const vector<int> &removedAllowed);
+    static double getEntropyBound(uint32_t guess, const LetterCounts &letters);
+    shared_ptr<const vector<bool>> getCandidates(
+        Trie<N>::Query query,
+        const Trie<N>::Live *live = nullptr) const;
+    shared_ptr<const Trie<N>::Live> getLive(const Stat *parent,
+                                            const vector<bool> &candidates) const;
+    shared_ptr<const GuessClasses> getClasses(
+        const GuessClasses *parent,
+        const vector<bool> &candidates) const;
+    vector<Word> getEntropies(const Stat &stat, const vector<int> &ids) const;
+    vector<Word> getEntropies(const vector<int> &ids,
+                              const vector<uint32_t> &words) const;
+    static vector<uint32_t> getSample(const vector<uint32_t> &words, int size);
+    vector<EntropyEstimate> estimateEntropies(const vector<int> &ids,
+                                              const vector<uint32_t> &sample,
+                                              int count) const;
+    static EntropyEstimate estimateEntropy(uint32_t guess,
+                                           const vector<uint32_t> &sample,
+                                           int count);
+    string getAdversarialPattern(const string &guess);
+    static int minimax(const vector<uint32_t> &guesses,
+                       const vector<uint32_t> &candidates,
+                       int depth,
+                       int bound);
+    static int minimax(const vector<uint32_t> &guesses,
+                       const vector<uint32_t> &candidates,
+                       uint32_t guess,
+                       int depth,
+                       int bound);
+    string getStateKey(const vector<bool> &candidates) const;
+    uint64_t getFingerprint() const;
+    static int writeCache(const Cache &cache, ostream &cacheFile);
+    static void readEntries(Cache &cache,
+                            const WordIndex<N> &index,
+                            const vector<bool> &allowed,
+                            istream &file,
+                            bool merge);
+    static string serializeEntry(const string &key, const TopWords &topWords);
+    shared_ptr<const EntropyTable> getEntropyTable(const string &key) const;
+    void storeEntropies(const string &key, const vector<Word> &words) const;
+    static void storeTopWords(Cache &cache,
+                              const string &key,
+                              const TopWords &entry);
+    static void evict(Cache &cache);
+    static size_t getEntryBytes(const string &key, const TopWords &entry);
+    static size_t getEntryBytes(const string &key, const EntropyTable &table);
+
     string targetWord;
     int guesses;
     static const int maxGuesses = 6;
     GameStatus status;
-    Trie<N> wordTrie;
+    GameMode mode = GameMode::NORMAL;
+    EntropyMode entropyMode = EntropyMode::EXACT;
+    // states with fewer than 4 times as many words are evaluated exactly
+    int sampleSize = 256;
+    Evaluator evaluator;
+    mt19937 random{ random_device()() };
+    vector<Stat> stats;
+
+    // the word lists and caches are shared by copies of the engine
+    shared_ptr<Trie<N>> wordTrie;
     Trie<N>::ID allowedID = Trie<N>::ID::ALLOWED;
     Trie<N>::ID possibleID = Trie<N>::ID::ALLOWED;
-    vector<Stat> stats;
-    priority_queue<Word> wordlist;
-    Cache cache;
-};
\ No newline at end of file
+    // allowed and possible words, flags are indexed by id
+    shared_ptr<WordIndex<N>> wordIndex;
+    shared_ptr<vector<bool>> isAllowed, isPossible;
+    shared_ptr<Cache> cache;
+    // shared with the other solver processes on this machine, optional
+    shared_ptr<SharedCache> sharedCache;
+    // last, so the writer stops before the cache it reads is destroyed
+    shared_ptr<CacheLog> cacheLog;
+};
+/**
+ * @brief Visit the remaining words of the ith state without copying them,
+ * return false from the visitor to stop early
+ */
+template <typename Visitor>
+int Wordle::forEachWord(int i, Visitor &&visit) const
+{
+    return wordTrie->forEach(getStat(i).query, visit);
+}
+
+/**
+ * @brief ids of the remaining words in id order, which is alphabetical unless
+ * words were added since, computed lazily.
+ * eg. page with getCandidateIds(stat) | views::drop(k) | views::take(k)
+ */
+inline auto Wordle::getCandidateIds(const Stat &stat) const
+{
+    // states from before words were added do not know their ids
+    return views::iota(0, wordIndex->size()) |
+           views::filter([candidates = stat.candidates](int id) {
+               return candidates && id < candidates->size() && (*candidates)[id];
+           });
+}
@@ -1,14 +1,19 @@
 #include "wordleLoop.h"
+#include <algorithm>
+#include <cassert>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <utility>
 #include "ProgressBar.h"
 
 using namespace std;
 
 WordleLoop::WordleLoop(const string &allowedFilepath,
                        const string &possibleFilepath,
-                       const string &cacheFilepath)
-    : WordleLoop(allowedFilepath, "", possibleFilepath, cacheFilepath)
+                       const string &cacheFilepath,
+                       const MemoryBudget &budget)
+    : WordleLoop(allowedFilepath, "", possibleFilepath, cacheFilepath, budget)
 {
     setRandomTargetWord();
 }
@@ -16,8 +21,11 @@ WordleLoop::WordleLoop(const string &allowedFilepath,
 WordleLoop::WordleLoop(const string &allowedFilepath,
                        const string &word,
                        const string &possibleFilepath,
-                       const string &cacheFilepath)
-    : Wordle(allowedFilepath, word, possibleFilepath, cacheFilepath)
+                       const string &cacheFilepath,
+                       const MemoryBudget &budget)
+    : Wordle(allowedFilepath, word, possibleFilepath, cacheFilepath),
+      wordsQuery(getStat(0).query),
+      cache(make_shared<Cache>())
 {
     ifstream possibleFile(possibleFilepath);
 
@@ -27,50 +35,164 @@ WordleLoop::WordleLoop(const string &allowedFilepath,
         exit(1);
     }
 
+    auto &index = getWordIndex();
+    cache->columns.assign(index.size(), -1);
     string possibleWord;
-    while (possibleFile >> possibleWord) words.push_back(possibleWord);
+    while (possibleFile >> possibleWord)
+    {
+        // words the index has no id for are skipped
+        int id = index.id(possibleWord);
+        if (id == -1) continue;
+        cache->columns[id] = cache->words.size();
+        cache->words.push_back(id);
+    }
     possibleFile.close();
+    cache->stride = cache->words.size();
+
+    words = cache->words;
+    // builds the pattern table if it fits
+    setMemoryBudget(budget);
+
+    // probably dont save it since its large, numpy i think compresses the output, and also 3b1b used a number to represent the pattern
+    // savePatternCache();
+}
 
-    copy(words.begin(), words.end(), back_inserter(cache.words));
+void WordleLoop::buildPatterns()
+{
+    if (loadPatternCache()) return;
 
     // calculate all patterns
-    if (!loadPatternCache())
+    cout << "Calculating patterns..." << endl;
+    auto &index = getWordIndex();
+    vector<uint8_t> patterns(1ull * index.size() * cache->stride);
+    ProgressBar progressBar(patterns.size());
+    int i = 0;
+    progressBar.update(i);
+    for (auto &target : cache->words)
+        for (int guess = 0; guess < index.size(); guess++)
+        {
+            patterns[cell(guess, target)] =
+                getPatternCode(index.packed(guess), index.packed(target));
+            progressBar.update(++i);
+        }
+    progressBar.finish();
+    cache->patterns = make_shared<const vector<uint8_t>>(move(patterns));
+}
+
+vector<Wordle::MemoryUsage> WordleLoop::getMemoryUsage() const
+{
+    auto lock = lockWords();
+    auto usage = Wordle::getMemoryUsage();
+    size_t patterns = cache->patterns ? cache->patterns->size() : 0;
+    usage.push_back({
+        "pattern table",
+        patterns +
+            (cache->words.capacity() + cache->columns.capacity() + words.capacity()) *
+                sizeof(int),
+        patterns,
+    });
+    return usage;
+}
+
+/**
+ * @brief Drops the pattern table if it is over the budget, patterns are then
+ * computed from the packed words on every lookup
+ */
+void WordleLoop::setMemoryBudget(const MemoryBudget &budget)
+{
+    auto lock = lockWords(true);
+    Wordle::setMemoryBudget(budget);
+    size_t bytes = 1ull * getWordIndex().size() * cache->stride;
+    if (bytes > budget.patterns) cache->patterns.reset();
+    else if (!cache->patterns) buildPatterns();
+}
+
+// position of a pattern in the table
+size_t WordleLoop::cell(int guessId, int wordId) const
+{
+    return 1ull * guessId * cache->stride + cache->columns[wordId];
+}
+
+uint8_t WordleLoop::pattern(int guessId, int wordId) const
+{
+    assert(guessId != -1 && wordId != -1);
+    // words removed since a copy's game started have no column
+    if (!cache->patterns || cache->columns[wordId] == -1)
+    {
+        auto &index = getWordIndex();
+        return getPatternCode(index.packed(guessId), index.packed(wordId));
+    }
+    return (*cache->patterns)[cell(guessId, wordId)];
+}
+
+/**
+ * @brief Keep the pattern table in step with the possible words. Only the
+ * columns of the added words and the rows of new guesses are computed, the
+ * table is only laid out again when it needs more columns
+ */
+void WordleLoop::updatePossibleWords(const vector<int> &added,
+                                     const vector<int> &removed)
+{
+    auto &index = getWordIndex();
+    int rows = cache->columns.size();
+    cache->columns.resize(index.size(), -1);
+    for (int id : removed)
+    {
+        cache->freeColumns.push_back(cache->columns[id]);
+        cache->columns[id] = -1;
+    }
+    auto isRemoved = [this](int id) { return cache->columns[id] == -1; };
+    erase_if(cache->words, isRemoved);
+    // they are gone from the game in progress too
+    erase_if(words, isRemoved);
+
+    int stride = cache->stride;
+    for (int id : added)
     {
-        ifstream allowedFile(allowedFilepath);
-        if (!allowedFile.is_open())
+        if (cache->freeColumns.empty()) cache->columns[id] = stride++;
+        else
         {
-            cerr << "Error opening file: " << allowedFilepath << endl;
-            exit(1);
+            cache->columns[id] = cache->freeColumns.back();
+            cache->freeColumns.pop_back();
         }
-        string allowedWord;
-        list<string> guesses;
-        while (allowedFile >> allowedWord) guesses.push_back(allowedWord);
-        allowedFile.close();
-
-        cout << "Calculating patterns..." << endl;
-        ProgressBar progressBar(1ull * words.size() * guesses.size());
-        int i = 0;
-        progressBar.update(i);
-        for (auto &target : words)
-            for (auto &guess : guesses)
-            {
-                cache.patterns[guess + target] = getPattern(guess, target);
-                progressBar.update(++i);
-            }
-        progressBar.finish();
+        cache->words.push_back(id);
     }
 
-    // probably dont save it since its large, numpy i think compresses the output, and also 3b1b used a number to represent the pattern
-    // savePatternCache();
+    // the table is laid out again for the new stride
+    auto old = move(cache->patterns);
+    int oldStride = exchange(cache->stride, stride);
+    if (old && 1ull * index.size() * stride <= getMemoryBudget().patterns)
+    {
+        vector<uint8_t> patterns(1ull * index.size() * stride);
+        for (int guess = 0; guess < rows; guess++)
+            copy_n(old->begin() + 1ull * guess * oldStride, oldStride,
+                   patterns.begin() + 1ull * guess * stride);
+        for (int guess = 0; guess < index.size(); guess++)
+        {
+            uint32_t packed = index.packed(guess);
+            // a new row needs every word, an old one only the added words
+            for (int word : guess < rows ? added : cache->words)
+                patterns[cell(guess, word)] =
+                    getPatternCode(packed, index.packed(word));
+        }
+        cache->patterns = make_shared<const vector<uint8_t>>(move(patterns));
+    }
+    old.reset();
+    // builds the table if it now fits
+    setMemoryBudget(getMemoryBudget());
 }
 
 bool WordleLoop::savePatternCache() const
 {
+    auto lock = lockWords();
     ofstream cacheFile("patterns.txt");
     if (!cacheFile.is_open()) return false;
 
-    for (auto &pattern : cache.patterns)
-        cacheFile << pattern.first << " " << pattern.second << endl;
+    auto &index = getWordIndex();
+    for (int guess = 0; guess < index.size(); guess++)
+        for (auto &target : cache->words)
+            cacheFile << index.word(guess) << index.word(target) << " "
+                      << getPattern(pattern(guess, target)) << endl;
 
     cacheFile.close();
     return true;
@@ -78,20 +200,31 @@ bool WordleLoop::savePatternCache() const
 
 bool WordleLoop::loadPatternCache()
 {
+    auto lock = lockWords(true);
     ifstream cacheFile("patterns.txt");
     if (!cacheFile.is_open()) return false;
     cout << "Using cached patterns..." << endl;
-    string word, pattern;
-    while (cacheFile >> word >> pattern) cache.patterns[word] = pattern;
+    auto &index = getWordIndex();
+    vector<uint8_t> patterns(1ull * index.size() * cache->stride);
+    string word, tiles;
+    while (cacheFile >> word >> tiles)
+    {
+        int guess = index.id(word.substr(0, N)),
+            target = index.id(word.substr(N));
+        if (guess == -1 || target == -1 || cache->columns[target] == -1)
+            continue;
+        patterns[cell(guess, target)] = getPatternCode(tiles);
+    }
 
     cacheFile.close();
+    cache->patterns = make_shared<const vector<uint8_t>>(move(patterns));
     return true;
 }
 
 /**
  * hacky solution, this functions shouldve been a const function
  * @see WordleLoop::getQueryCount
- * @see WordleLoop::getPatternsCounts
+ * @see WordleLoop::countPatterns
  */
 Trie<Wordle::N>::Query WordleLoop::getUpdatedQuery(const string &guess,
                                                    const string &pattern,
@@ -99,40 +232,82 @@ Trie<Wordle::N>::Query WordleLoop::getUpdatedQuery(const string &guess,
 {
     auto newQuery = Wordle::getUpdatedQuery(guess, pattern, query);
 
-    words.remove_if([&guess, &pattern, this](const string &word) {
-        return cache.patterns.at(guess + word) != pattern;
+    auto &index = getWordIndex();
+    int guessId = index.id(guess);
+    uint8_t code = getPatternCode(pattern);
+    // words another copy removed go too. a guess outside the lists has no
+    // row, the query filters the words then
+    erase_if(words, [&](int word) {
+        if (cache->columns[word] == -1) return true;
+        if (guessId == -1) return !newQuery.verify(index.word(word));
+        return this->pattern(guessId, word) != code;
     });
+    wordsQuery = newQuery;
 
     return newQuery;
 }
 
 void WordleLoop::reset()
 {
+    auto lock = lockWords();
     Wordle::reset();
-    words.clear();
-    copy(cache.words.begin(), cache.words.end(), back_inserter(words));
+    words = cache->words;
+    wordsQuery = getStat(0).query;
 }
 
-/**
- * @brief may cause runtime bugs as it does not depend on the query, only works because super class only ever accesses the most recent query
- */
-int WordleLoop::getQueryCount(Trie<N>::Query query) const
+// the copy shares the possible words and their pattern table, the caches of
+// the base engine too
+shared_ptr<Wordle> WordleLoop::clone() const
 {
-    return words.size();
+    return make_shared<WordleLoop>(*this);
 }
 
 /**
- * @brief may cause runtime bugs as it does not depend on the query, only works because super class only ever accesses the most recent query
+ * @brief possible words matching the query. The latest state's words are
+ * kept and returned as they are, the words of any other query are filtered
+ * from the whole list into matching
  */
-unordered_map<string, int> WordleLoop::getPatternsCounts(const string &guess,
-                                               Trie<N>::Query query) const
+const vector<int> &WordleLoop::getMatchingWords(Trie<N>::Query query,
+                                                vector<int> &matching) const
 {
-    unordered_map<string, int> patterns;
-    for (auto &word : words)
+    auto isRemoved = [this](int id) { return cache->columns[id] == -1; };
+    matching.clear();
+    if (query == wordsQuery)
     {
-        string pattern = cache.patterns.at(guess + word);
-        patterns[pattern]++;
+        // another copy may have removed some of them since
+        if (ranges::none_of(words, isRemoved)) return words;
+        ranges::remove_copy_if(words, back_inserter(matching), isRemoved);
+        return matching;
     }
 
+    auto &index = getWordIndex();
+    for (auto &word : cache->words)
+        if (query.verify(index.word(word))) matching.push_back(word);
+    return matching;
+}
+
+int WordleLoop::getQueryCount(Trie<N>::Query query) const
+{
+    auto lock = lockWords();
+    vector<int> matching;
+    return getMatchingWords(query, matching).size();
+}
+
+unordered_map<string, int> WordleLoop::countPatterns(
+    const string &guess,
+    Trie<N>::Query query,
+    const Trie<N>::Live *live) const
+{
+    int guessId = getWordIndex().id(guess), counts[243] = { 0 };
+    // a guess outside the lists has no row in the table
+    if (guessId == -1) return Wordle::countPatterns(guess, query, live);
+    vector<int> matching;
+    for (auto &word : getMatchingWords(query, matching))
+        counts[pattern(guessId, word)]++;
+
+    unordered_map<string, int> patterns;
+    for (int code = 0; code < 243; code++)
+        if (counts[code]) patterns[getPattern(code)] = counts[code];
+
     return patterns;
-}
\ No newline at end of file
+}
@@ -1,7 +1,7 @@
 #pragma once
-#include <list>
+#include <cstdint>
 #include <string>
-#include "Wordle.h"
+#include "wordle.h"
 
 using namespace std;
 
@@ -9,16 +9,19 @@ class WordleLoop : public Wordle {
    public:
     WordleLoop(const string &allowedFilepath,
                const string &possibleFilepath,
-               const string &cacheFilepath = "");
+               const string &cacheFilepath = "",
+               const MemoryBudget &budget = {});
     WordleLoop(const string &allowedFilepath,
                const string &word,
                const string &possibleFilepath,
-               const string &cacheFilepath);
+               const string &cacheFilepath,
+               const MemoryBudget &budget = {});
 
-    unordered_map<string, int> getPatternsCounts(const string &guess,
-                                       Trie<N>::Query query) const override;
     int getQueryCount(Trie<N>::Query query) const override;
     void reset() override;
+    shared_ptr<Wordle> clone() const override;
+    vector<MemoryUsage> getMemoryUsage() const override;
+    void setMemoryBudget(const MemoryBudget &budget) override;
     bool loadPatternCache();
     bool savePatternCache() const;
 
@@ -26,13 +29,39 @@ class WordleLoop : public Wordle {
     Trie<N>::Query getUpdatedQuery(const string &guess,
                                    const string &pattern,
                                    Trie<N>::Query query) override;
+    void updatePossibleWords(const vector<int> &added,
+                             const vector<int> &removed) override;
+    unordered_map<string, int> countPatterns(
+        const string &guess,
+        Trie<N>::Query query,
+        const Trie<N>::Live *live) const override;
 
    private:
+    // shared by the copies of the engine so they all count the current words.
+    // updateWords changes it under the exclusive lock of the words, the
+    // calls reading it hold that lock shared
     struct Cache {
-        list<string> words;
-        unordered_map<string, string> patterns;
+        // ids of the possible words
+        vector<int> words;
+        // pattern code of every guess against every possible word, row is
+        // the guess id, column is the column of the word. null if it does
+        // not fit the memory budget
+        shared_ptr<const vector<uint8_t>> patterns;
+        vector<int> columns;  // id -> column, -1 if not possible
+        int stride = 0;       // columns per row
+        // columns of removed words, reused by the words added next
+        vector<int> freeColumns;
     };
-    list<string> words;
+    // remaining words of the latest state and its query. a copy keeps the
+    // words another copy removed, they are skipped by their column
+    vector<int> words;
+    Trie<N>::Query wordsQuery;
 
-    Cache cache;
+    void buildPatterns();
+    const vector<int> &getMatchingWords(Trie<N>::Query query,
+                                        vector<int> &matching) const;
+    size_t cell(int guessId, int wordId) const;
+    uint8_t pattern(int guessId, int wordId) const;
+
+    shared_ptr<Cache> cache;
 };
\ No newline at end of file
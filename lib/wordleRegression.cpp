@@ -1,4 +1,5 @@
 #include "wordleRegression.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
@@ -16,6 +17,11 @@ WordleRegression::WordleRegression(const string &allowedFilepath,
     : Wordle(allowedFilepath, word, possibleFilepath, cacheFilepath)
 {}
 
+shared_ptr<Wordle> WordleRegression::clone() const
+{
+    return make_shared<WordleRegression>(*this);
+}
+
 double WordleRegression::expectedScore(double remainingBits)
 {
     // 0.00323876x^{3}-0.0646617x^{2}+0.540225x+0.989117
@@ -26,16 +32,36 @@ double WordleRegression::expectedScore(double remainingBits)
 }
 
 vector<Wordle::Word> WordleRegression::getTopNWords(const int n,
-                                                    bool showProgress)
+                                                    const Stat &stat,
+                                                    bool showProgress) const
+{
+    return rescore(Wordle::getTopNWords(n, stat, showProgress), stat);
+}
+
+vector<Wordle::Word> WordleRegression::getTopNWords(
+    const int n,
+    const Stat &stat,
+    chrono::steady_clock::time_point deadline,
+    stop_token stop,
+    bool &exact) const
 {
-    vector<Word> result = Wordle::getTopNWords(n, showProgress);
-    auto stat = getStat(-1);
-    auto query = stat.query;
+    return rescore(Wordle::getTopNWords(n, stat, deadline, stop, exact), stat);
+}
+
+/**
+ * @brief order the words by the expected number of guesses instead
+ */
+vector<Wordle::Word> WordleRegression::rescore(vector<Word> result,
+                                               const Stat &stat) const
+{
+    // the expected score means nothing against an adversary
+    if (getGameMode() == GameMode::ADVERSARIAL) return result;
+
     double p = 1.0 / stat.count;
-    int guesses = getGuesses() + 1;
+    int guesses = stat.turn + 1;
     for (auto &word : result)
     {
-        if (isInWordSpace(word.word, query))
+        if (isInWordSpace(word.id, stat))
         {
             // it can possibly be the answer,
             p = 1.0 / stat.count;
@@ -47,9 +73,12 @@ vector<Wordle::Word> WordleRegression::getTopNWords(const int n,
                 (guesses + expectedScore(stat.remainingBits - word.entropy));
     }
 
-    auto comp = [&query, this](const Word &a, const Word &b) {
-        if (!feq(a.score, b.score)) return a.score < b.score;
-        if (isInWordSpace(a.word, query)) return true;
+    // scores are compared on a grid, feq is not transitive
+    auto comp = [&stat, this](const Word &a, const Word &b) {
+        if (scoreKey(a.score) != scoreKey(b.score))
+            return scoreKey(a.score) < scoreKey(b.score);
+        bool inA = isInWordSpace(a.id, stat), inB = isInWordSpace(b.id, stat);
+        if (inA != inB) return inA;
         return false;
     };
     sort(result.begin(), result.end(), comp);
@@ -13,8 +13,18 @@ class WordleRegression : public Wordle {
                      const string &word,
                      const string &possibleFilepath,
                      const string &cacheFilepath);
-    vector<Word> getTopNWords(const int n, bool showProgress = false) override;
+    shared_ptr<Wordle> clone() const override;
+    using Wordle::getTopNWords;
+    vector<Word> getTopNWords(const int n,
+                              const Stat &stat,
+                              bool showProgress = false) const override;
+    vector<Word> getTopNWords(const int n,
+                              const Stat &stat,
+                              chrono::steady_clock::time_point deadline,
+                              stop_token stop,
+                              bool &exact) const override;
 
    private:
-    double expectedScore(double remainingBits);
+    vector<Word> rescore(vector<Word> result, const Stat &stat) const;
+    static double expectedScore(double remainingBits);
 };
\ No newline at end of file
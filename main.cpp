@@ -1,8 +1,12 @@
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#include <charconv>
+#include <cstring>
 #include <iostream>
 #include "Simulator.h"
+#include "dictionaries.h"
+#include "precomputer.h"
 #include "wordle.h"
 #include "wordleLoop.h"
 #include "wordleRegression.h"
@@ -11,27 +15,114 @@ using namespace std;
 const string allowedFilepath = "res/3b1b/allowed_words.txt";
 const string possibleFilepath = "res/3b1b/possible_words.txt";
 const string cacheFilepath = "entropy_cache.txt";
+// every word is allowed and can be the answer
+const string wordleFilepath = "res/wordle/words";
+// shared by the solver processes on this machine, one segment per list
+const string sharedCacheName = "/wordle_solver_cache";
+const string usage =
+    "Usage: WordleSolver [--list name] [--seed s] [--shard i/n [--out file]]";
 
-int main()
+// With --shard, plays the ith of n parts of the simulation and writes its
+// games to the file (shard_<i>_of_<n>.bin by default) for MergeShards,
+// without asking anything. --seed makes the random targets reproducible
+int main(int argc, char *argv[])
 {
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
 #endif
-    WordleRegression wordle(allowedFilepath, possibleFilepath, cacheFilepath);
-    Simulator sim(possibleFilepath, wordle);
+    string name, outPath;
+    int shardIndex = -1, shardCount = 0;
+    bool seeded = false;
+    uint64_t seed;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        if (strcmp(option, "--list") && strcmp(option, "--out") &&
+            strcmp(option, "--seed") && strcmp(option, "--shard"))
+        {
+            cerr << "Unknown option: " << option << endl << usage << endl;
+            return 1;
+        }
+        if (i + 1 == argc)
+        {
+            cerr << "Missing value for " << option << endl << usage << endl;
+            return 1;
+        }
+
+        const char *value = argv[++i], *end = value + strlen(value);
+        char rest;
+        if (!strcmp(option, "--list")) name = value;
+        else if (!strcmp(option, "--out")) outPath = value;
+        else if (!strcmp(option, "--seed"))
+        {
+            auto result = from_chars(value, end, seed);
+            if (result.ec != errc() || result.ptr != end)
+            {
+                cerr << "Invalid seed: " << value << endl;
+                return 1;
+            }
+            seeded = true;
+        }
+        else if (sscanf(value, "%d/%d%c", &shardIndex, &shardCount, &rest) != 2 ||
+                 shardIndex < 0 || shardIndex >= shardCount)
+        {
+            cerr << "Invalid shard: " << value << endl;
+            return 1;
+        }
+    }
+
+    Dictionaries dictionaries("", sharedCacheName);
+    dictionaries.add("3b1b", allowedFilepath, possibleFilepath, cacheFilepath);
+    dictionaries.add("wordle", wordleFilepath);
+    if (seeded) dictionaries.setSeed(seed);
+
+    if (name.empty() && shardCount == 0)
+    {
+        cout << "Word list (3b1b/wordle): ";
+        cin >> name;
+    }
+    // a shard run without --list plays the 3b1b list
+    if (name.empty()) name = "3b1b";
+    if (!dictionaries.contains(name))
+    {
+        cerr << "Unknown word list: " << name << endl << usage << endl;
+        return 1;
+    }
+    auto session = dictionaries.newSession(name);
+    WordleRegression &wordle = *session;
+    Simulator sim(name == "3b1b" ? possibleFilepath : wordleFilepath, wordle);
+
+    if (shardCount)
+    {
+        if (outPath.empty())
+            outPath = "shard_" + to_string(shardIndex) + "_of_" +
+                      to_string(shardCount) + ".bin";
+        sim.setShard(shardIndex, shardCount);
+        sim.setPointsPath("");
+        sim.setPartialPath(outPath);
+        if (seeded) sim.setSeed(seed);
+        sim.runTree(100);
+        return 0;
+    }
 
     cout << "Run simulator? (y/n): ";
     char choice;
     cin >> choice;
     if (choice == 'y')
     {
-        sim.run(100);
-        wordle.saveCache();
+        sim.runTree(100);
+        wordle.printMemoryUsage();
         wordle.reset();
         wordle.setRandomTargetWord();
     }
 
+    cout << "Adversarial mode? (y/n): ";
+    cin >> choice;
+    if (choice == 'y') wordle.setGameMode(Wordle::GameMode::ADVERSARIAL);
+
     cout << "Starting game..." << endl;
+    // ranks the likely next states while the guess is typed
+    Precomputer precomputer(wordle, 10);
 
     while (true)
     {
@@ -46,6 +137,8 @@ int main()
             // stat.query.print();
 
             if (wordle.isGameOver()) break;
+            auto suggestions = wordle.getTopNWords(10);
+            if (!suggestions.empty()) precomputer.start(suggestions[0].word);
 
             string guess;
             cout << "\nEnter guess " << wordle.getGuesses() + 1 << "/"
@@ -55,6 +148,19 @@ int main()
             cin.clear();
 
             for (auto &c : guess) c = tolower(c);
+            // rankings in progress give way to the one the guess needs
+            precomputer.stop();
+
+            // "+word" and "-word" add and remove an answer without a restart
+            if (guess.size() > 1 && (guess[0] == '+' || guess[0] == '-'))
+            {
+                vector<string> words = { guess.substr(1) };
+                int changed = guess[0] == '+' ? wordle.updateWords(words, {})
+                                              : wordle.updateWords({}, words);
+                cout << (changed ? "Answers updated" : "Nothing to update") << endl;
+                stat = wordle.getStat(-1);
+                continue;
+            }
 
             if (!wordle.isWordValid(guess))
             {
@@ -77,8 +183,8 @@ int main()
                 break;
         }
 
+        // new cache entries are persisted in the background
         cout << "Resetting game..." << endl << endl;
-        wordle.saveCache();
         wordle.reset();
         wordle.setRandomTargetWord();
     }
@@ -0,0 +1,33 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Simulator.h"
+
+using namespace std;
+
+// Usage: MergeShards [--points file] <shard file>...
+// Combines the partial results written by WordleSolver --shard into the
+// report of the whole simulation, and writes its points (points.txt by default)
+int main(int argc, char *argv[])
+{
+    string pointsPath = "points.txt";
+    vector<string> partialPaths;
+    const string usage = "Usage: MergeShards [--points file] <shard file>...";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--points")) partialPaths.push_back(argv[i]);
+        else if (i + 1 < argc) pointsPath = argv[++i];
+        else
+        {
+            cerr << "Missing value for --points" << endl << usage << endl;
+            return 1;
+        }
+    }
+    if (partialPaths.empty())
+    {
+        cerr << usage << endl;
+        return 1;
+    }
+    return Simulator::merge(partialPaths, pointsPath) ? 0 : 1;
+}
@@ -1,11 +1,90 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "cacheLog.h"
+#include "Simulator.h"
+#include "batchEvaluator.h"
+#include "cacheWarmer.h"
+#include "dictionaries.h"
+#include "engineHarness.h"
+#include "multiWordle.h"
+#include "parallel.h"
+#include "precomputer.h"
+#include "sharedCache.h"
 #include "trie.h"
+#include "wordIndex.h"
 #include "wordle.h"
+#include "wordleLoop.h"
+#include "wordleRegression.h"
 
 const string filepath = "res/wordle/words";
 const string EntropyCache = "entropy_cache_TEST.txt";
 
+// small word lists for tests that need to know every word
+static void writeWords(const string &path, const vector<string> &words)
+{
+    ofstream file(path, ios::trunc);
+    for (auto &word : words) file << word << endl;
+}
+
+// tests on small word lists. every file of a test is named after it, so
+// tests can run in parallel, and removed again when the test ends
+class SMALL_LISTS : public testing::Test {
+   protected:
+    const vector<string> words = { "crane", "crave", "craze", "venge", "vezir",
+                                   "slate", "trace", "brick", "prick", "grind",
+                                   "eerie", "geese", "sassy", "abbey", "fuzzy" };
+    const string allowed = file("allowed"), possible = file("possible"),
+                 cache = file("entropy_cache");
+
+    // path of a file of the running test
+    static string file(const string &name, const string &extension = ".txt")
+    {
+        return name + tag() + extension;
+    }
+
+    // both lists hold the words, possible defaults to the allowed ones
+    void writeLists(const vector<string> &allowedWords,
+                    const vector<string> &possibleWords = {})
+    {
+        writeWords(allowed, allowedWords);
+        writeWords(possible, possibleWords.empty() ? allowedWords : possibleWords);
+    }
+
+    void SetUp() override
+    {
+        removeFiles();
+        writeLists(words);
+    }
+
+    void TearDown() override { removeFiles(); }
+
+   private:
+    static string tag()
+    {
+        auto test = testing::UnitTest::GetInstance()->current_test_info();
+        return string("-") + test->name() + "_TEST";
+    }
+
+    // cache logs, locks and anything else the test named with file()
+    static void removeFiles()
+    {
+        for (auto &entry : filesystem::directory_iterator("."))
+            if (entry.path().filename().string().find(tag()) != string::npos)
+                filesystem::remove_all(entry.path());
+    }
+};
+
 TEST(WORDLE, VALID_WORD)
 {
     Wordle wordle(filepath, "aahed", "", EntropyCache);
@@ -281,6 +360,1060 @@ TEST(WORDLE, QUERY_EXISTS)
     EXPECT_FALSE(stat.query.verify("swees"));
 }
 
+TEST_F(SMALL_LISTS, EQUIVALENT_GUESSES)
+{
+    writeLists({ "crane", "crave", "craze", "venge", "vezir" },
+               { "crane", "crave", "craze" });
+
+    Wordle wordle(allowed, "crane", possible, cache);
+
+    // venge and vezir both split the words into singletons
+    EXPECT_EQ(wordle.getPartition(-1, "venge"),
+              wordle.getPartition(-1, "vezir"));
+    EXPECT_NE(wordle.getPartition(-1, "crane"),
+              wordle.getPartition(-1, "crave"));
+
+    auto result = wordle.getTopNWords(10);
+    ASSERT_EQ(result.size(), 4);
+    EXPECT_TRUE(result[0].word == "venge" || result[0].word == "vezir");
+    vector<string> rest = { result[1].word, result[2].word, result[3].word };
+    EXPECT_EQ(rest, vector<string>({ "crane", "crave", "craze" }));
+
+    // every guess separates the two words, the answer dominates the rest
+    writeLists({ "crane", "crave", "venge" }, { "crane", "crave" });
+    filesystem::remove(cache);
+
+    Wordle dominated(allowed, "crane", possible, cache);
+    result = dominated.getTopNWords(10);
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_TRUE(dominated.isInWordSpace(result[0].word, dominated.getStat(-1)));
+
+    // the classes of a state are merged from the classes before it
+    writeLists(words);
+    filesystem::remove(cache);
+    Wordle game(allowed, "crane", possible, cache);
+    auto initial = game.getStat(0), stat = game.guess("slate");
+    ASSERT_TRUE(initial.classes && stat.classes);
+    auto &classes = *stat.classes;
+    auto &index = game.getWordIndex();
+    EXPECT_LT(classes.starts.size(), initial.classes->starts.size());
+    EXPECT_EQ(classes.ids.size(), words.size());
+    set<string> partitions;
+    for (int c = 0; c + 1 < classes.starts.size(); c++)
+    {
+        auto partitionOf = [&](int i) {
+            return game.getPartition(-1, index.word(classes.ids[i]));
+        };
+        string partition = partitionOf(classes.starts[c]);
+        for (int i = classes.starts[c]; i < classes.starts[c + 1]; i++)
+            EXPECT_EQ(partitionOf(i), partition);
+        partitions.insert(partition);
+    }
+    EXPECT_EQ(partitions.size(), classes.starts.size() - 1);
+
+    // one guess per class is ranked
+    partitions.clear();
+    for (auto &word : game.getTopNWords(words.size()))
+        EXPECT_TRUE(partitions.insert(game.getPartition(-1, word.word)).second);
+}
+
+TEST_F(SMALL_LISTS, STATE_KEY)
+{
+    writeLists({ "crane", "crave", "craze", "venge", "vezir" },
+               { "crane", "crave", "craze" });
+
+    Wordle first(allowed, "crane", possible, cache);
+    Wordle second(allowed, "crane", possible, cache);
+    auto root = first.getStat(-1).key;
+    EXPECT_EQ(root, second.getStat(-1).key);
+
+    // different guesses, same remaining word
+    auto stat1 = first.guess("venge"), stat2 = second.guess("vezir");
+    EXPECT_NE(stat1.query.serialize(), stat2.query.serialize());
+    EXPECT_EQ(stat1.key, stat2.key);
+    EXPECT_NE(stat1.key, root);
+
+    EXPECT_TRUE(first.isInWordSpace("crave", first.getStat(0)));
+    EXPECT_TRUE(first.isInWordSpace("crane", stat1));
+    EXPECT_FALSE(first.isInWordSpace("crave", stat1));
+    EXPECT_FALSE(first.isInWordSpace("venge", stat1));
+    EXPECT_FALSE(first.isInWordSpace("zzzzz", stat1));
+}
+
+TEST_F(SMALL_LISTS, CONCURRENT_TOP_WORDS)
+{
+    Wordle wordle(allowed, "crane", possible, cache);
+    Wordle expected(allowed, "crane", possible, cache);
+    wordle.guess("slate");
+    expected.guess("slate");
+
+    // every thread ranks the same states of one shared engine
+    vector<thread> threads;
+    vector<vector<string>> results(8);
+    for (int t = 0; t < results.size(); t++)
+        threads.emplace_back([&wordle, &results, t] {
+            for (auto &word : wordle.getTopNWords(3, wordle.getStat(t % 2)))
+                results[t].push_back(word.word);
+        });
+    for (auto &t : threads) t.join();
+
+    for (int t = 0; t < results.size(); t++)
+    {
+        vector<string> serial;
+        for (auto &word : expected.getTopNWords(3, expected.getStat(t % 2)))
+            serial.push_back(word.word);
+        EXPECT_EQ(results[t], serial);
+    }
+
+    // the initial ranking is shared, resetting does not rebuild it
+    wordle.reset();
+    EXPECT_EQ(wordle.getStat(-1).key, expected.getStat(0).key);
+}
+
+TEST_F(SMALL_LISTS, ADVERSARIAL)
+{
+    writeLists({ "crane", "crave", "craze", "crate", "slate", "venge", "vezir" },
+               { "crane", "crave", "craze", "crate" });
+
+    Wordle wordle(allowed, "crate", possible, cache);
+    wordle.setGameMode(Wordle::GameMode::ADVERSARIAL);
+
+    auto result = wordle.getTopNWords(10);
+    for (int i = 1; i < result.size(); i++)
+        EXPECT_LE(result[i - 1].maxBucket, result[i].maxBucket);
+
+    // slate only tells crate apart, the host keeps the other three
+    auto stat = wordle.guess("slate");
+    EXPECT_EQ(stat.count, 3);
+    EXPECT_NE(wordle.getTargetWord(), "crate");
+    EXPECT_TRUE(wordle.isInWordSpace(wordle.getTargetWord(), stat));
+
+    result = wordle.getTopNWords(1, stat);
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_EQ(result[0].maxBucket, 1);
+
+    // venge and vezir split the rest into singletons, any answer needs three
+    auto strategy = wordle.solveAdversarial(stat, 6);
+    EXPECT_EQ(strategy.guess, "venge");
+    EXPECT_EQ(strategy.guesses, 2);
+    EXPECT_EQ(wordle.solveAdversarial(stat, 1).guesses, -1);
+
+    stat = wordle.guess(strategy.guess);
+    EXPECT_EQ(stat.count, 1);
+    wordle.guess(wordle.getTargetWord());
+    EXPECT_EQ(wordle.getStatus(), Wordle::GameStatus::WON);
+}
+
+TEST_F(SMALL_LISTS, MULTI_BOARD)
+{
+    Wordle wordle(allowed, "crane", possible, cache);
+    MultiWordle multi(wordle, { "crane", "brick", "slate" });
+    ASSERT_EQ(multi.getBoardCount(), 3);
+    EXPECT_EQ(multi.getMaxGuesses(), 8);
+
+    // the boards are independent, their entropies add up
+    EXPECT_NEAR(multi.getEntropy("trace").entropy,
+                3 * wordle.getEntropy(-1, "trace").entropy, 1e-9);
+
+    auto patterns = multi.guess("slate");
+    ASSERT_EQ(patterns.size(), 3);
+    EXPECT_EQ(patterns[0], Wordle::getPattern("slate", "crane"));
+    EXPECT_EQ(patterns[2], "CCCCC");
+    EXPECT_TRUE(multi.getBoard(2).solved);
+    EXPECT_FALSE(multi.isGameOver());
+
+    // the solved board drops out
+    Wordle first(allowed, "crane", possible, cache),
+        second(allowed, "brick", possible, cache);
+    first.guess("slate");
+    second.guess("slate");
+    for (auto &guess : words)
+        EXPECT_NEAR(multi.getEntropy(guess).entropy,
+                    first.getEntropy(-1, guess).entropy +
+                        second.getEntropy(-1, guess).entropy,
+                    1e-9)
+            << guess;
+
+    auto top = multi.getTopNWords(3);
+    ASSERT_FALSE(top.empty());
+    for (auto &guess : words)
+        EXPECT_LE(multi.getEntropy(guess).score, top[0].score + 1e-9);
+
+    while (!multi.isGameOver()) multi.guess(multi.getTopNWords(1)[0].word);
+    EXPECT_EQ(multi.getStatus(), Wordle::GameStatus::WON);
+    EXPECT_TRUE(multi.guess("crane").empty());
+
+    // random targets come from the engine's generator
+    first.setSeed(42);
+    second.setSeed(42);
+    MultiWordle seeded(first, 4), again(second, 4);
+    for (int i = 0; i < 4; i++)
+        EXPECT_EQ(seeded.getBoard(i).targetWord, again.getBoard(i).targetWord);
+}
+
+TEST_F(SMALL_LISTS, CACHE_WARMER)
+{
+    vector<Wordle::Word> expected;
+    {
+        Wordle wordle(allowed, "grind", possible, cache);
+        CacheWarmer warmer(wordle);
+        // the initial state and one state per pattern of the best word
+        auto best = wordle.getTopNWords(1)[0].word;
+        set<string> patterns;
+        for (auto &word : words)
+            if (word != best) patterns.insert(Wordle::getPattern(best, word));
+        EXPECT_GE(warmer.run(5, 1, false), 1 + patterns.size());
+        EXPECT_EQ(wordle.getGuesses(), 0);
+        EXPECT_EQ(wordle.getTargetWord(), "grind");
+
+        wordle.guess(best);
+        expected = wordle.getTopNWords(5);
+        ASSERT_TRUE(wordle.saveCache());
+    }
+
+    // a new engine finds the states in the cache file
+    filesystem::remove(CacheLog::logPath(cache));
+    Wordle wordle(allowed, "grind", possible, cache);
+    auto stat = wordle.guess(wordle.getTopNWords(1)[0].word);
+    auto result = wordle.getTopNWords(5, stat);
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); i++)
+        EXPECT_EQ(result[i].word, expected[i].word);
+}
+
+TEST_F(SMALL_LISTS, MEMORY_BUDGET)
+{
+    auto usage = [](const Wordle &wordle, const string &name) {
+        for (auto &part : wordle.getMemoryUsage())
+            if (part.name == name) return part;
+        return Wordle::MemoryUsage{ name, 0, 0 };
+    };
+
+    Wordle wordle(allowed, "grind", possible, cache);
+    EXPECT_GT(usage(wordle, "trie").bytes, 0);
+    EXPECT_EQ(usage(wordle, "word index").entries, words.size());
+    auto expected = wordle.getTopNWords(5, wordle.guess("slate"));
+    wordle.getTopNWords(5, wordle.guess("brick"));
+    EXPECT_EQ(usage(wordle, "top words cache").entries, 2);
+    EXPECT_EQ(usage(wordle, "entropy cache").entries, 3);
+
+    // the oldest entries go first, the initial state's entropies are kept
+    auto topWords = usage(wordle, "top words cache").bytes;
+    wordle.setMemoryBudget({ .topWords = topWords - 1, .entropies = 0 });
+    EXPECT_EQ(usage(wordle, "top words cache").entries, 1);
+    EXPECT_LT(usage(wordle, "top words cache").bytes, topWords);
+    EXPECT_EQ(usage(wordle, "entropy cache").entries, 1);
+
+    // evicted states are ranked again
+    wordle.reset();
+    auto result = wordle.getTopNWords(5, wordle.guess("slate"));
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); i++)
+        EXPECT_EQ(result[i].word, expected[i].word);
+
+    // without the pattern table the same patterns are computed on the fly
+    WordleLoop table(allowed, "grind", possible, cache),
+        compact(allowed, "grind", possible, cache, { .patterns = 0 });
+    EXPECT_EQ(usage(table, "pattern table").entries, words.size() * words.size());
+    EXPECT_EQ(usage(compact, "pattern table").entries, 0);
+    auto query = table.getStat(-1).query;
+    EXPECT_EQ(table.getPatternsCounts("slate", query),
+              compact.getPatternsCounts("slate", query));
+}
+
+TEST_F(SMALL_LISTS, ENTROPY_BOUND)
+{
+    // never below the entropy, repeated letters included
+    Wordle wordle(allowed, "crane", possible, cache);
+    for (auto &guess : { "", "eerie", "slate" })
+    {
+        auto stat = *guess ? wordle.guess(guess) : wordle.getStat(-1);
+        for (auto &word : words)
+            EXPECT_GE(wordle.getEntropyBound(stat, word),
+                      wordle.getEntropy(stat, word).entropy);
+    }
+
+    // nothing to learn about a single word
+    Wordle solved(allowed, "brick", possible, cache);
+    auto stat = solved.guess("prick");
+    ASSERT_EQ(stat.count, 1);
+    EXPECT_NEAR(solved.getEntropyBound(stat, "sassy"), 0, 1e-6);
+}
+
+TEST_F(SMALL_LISTS, SAMPLED_ENTROPY)
+{
+    vector<vector<Wordle::Word>> results;
+    for (auto mode : { Wordle::EntropyMode::EXACT, Wordle::EntropyMode::SAMPLED })
+    {
+        filesystem::remove(cache);
+        filesystem::remove(CacheLog::logPath(cache));
+        Wordle wordle(allowed, "crane", possible, cache);
+        // tiny samples, so that the state is large enough to be sampled
+        wordle.setEntropyMode(mode, 2);
+        auto stat = wordle.guess("fuzzy");
+        ASSERT_GE(stat.count, 8);
+        results.push_back(wordle.getTopNWords(3, stat));
+
+        // a sampled ranking is not stored as the exact one
+        wordle.saveCache();
+        stringstream content;
+        content << ifstream(cache).rdbuf();
+        string saved = content.str();
+        auto has = [&](const string &s) { return saved.find(s) != string::npos; };
+        bool isSampled = mode == Wordle::EntropyMode::SAMPLED;
+        EXPECT_EQ(has(stat.key + "-sampled "), isSampled);
+        EXPECT_EQ(has('\n' + stat.key + ' '), !isSampled);
+
+        // a sample of every word is exact
+        for (auto &word : words)
+        {
+            auto estimate = wordle.estimateEntropy(stat, word, stat.count);
+            EXPECT_NEAR(estimate.low, wordle.getEntropy(stat, word).entropy, 1e-9);
+            EXPECT_NEAR(estimate.high, estimate.low, 1e-9);
+        }
+    }
+
+    // the estimates only decide what is evaluated, the top words are exact
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for (int i = 0; i < results[0].size(); i++)
+    {
+        EXPECT_EQ(results[0][i].word, results[1][i].word);
+        EXPECT_NEAR(results[0][i].entropy, results[1][i].entropy, 1e-9);
+    }
+}
+
+TEST_F(SMALL_LISTS, DICTIONARIES)
+{
+    writeLists({ "crane", "crave", "craze", "venge", "vezir" },
+               { "slate", "trace", "brick", "prick", "grind", "crane" });
+    // the cache files are named after the lists
+    const string directory = file("caches", "");
+    filesystem::create_directory(directory);
+
+    Dictionaries dictionaries(directory);
+    dictionaries.add("small", allowed);
+    dictionaries.add("other", possible);
+    EXPECT_EQ(dictionaries.getNames(), vector<string>({ "other", "small" }));
+    EXPECT_EQ(dictionaries.get("missing"), nullptr);
+    EXPECT_EQ(dictionaries.newSession("missing"), nullptr);
+
+    // loaded once, however many callers want it at the same time
+    vector<shared_ptr<const WordleRegression>> loaded(4);
+    vector<thread> threads;
+    for (auto &engine : loaded)
+        threads.emplace_back([&] { engine = dictionaries.get("small"); });
+    for (auto &t : threads) t.join();
+    auto engine = loaded[0];
+    ASSERT_NE(engine, nullptr);
+    for (auto &other : loaded) EXPECT_EQ(other, engine);
+    EXPECT_EQ(dictionaries.get("small"), engine);
+    EXPECT_FALSE(dictionaries.get("other")->isWordValid("vezir"));
+
+    // sessions play their own games on the shared caches
+    auto first = dictionaries.newSession("small"),
+         second = dictionaries.newSession("small");
+    first->setTargetWord("crane");
+    second->setTargetWord("vezir");
+    auto ranked = first->getTopNWords(3, first->guess("venge"));
+    EXPECT_EQ(first->getGuesses(), 1);
+    EXPECT_EQ(second->getGuesses(), 0);
+    EXPECT_EQ(engine->getGuesses(), 0);
+
+    auto cached = [](const Wordle &wordle) {
+        for (auto &part : wordle.getMemoryUsage())
+            if (part.name == "top words cache") return part.entries;
+        return (size_t)0;
+    };
+    EXPECT_EQ(cached(*engine), 1);
+    second->setTargetWord("crane");
+    auto result = second->getTopNWords(3, second->guess("venge"));
+    EXPECT_EQ(cached(*engine), 1);
+    ASSERT_EQ(result.size(), ranked.size());
+    for (int i = 0; i < result.size(); i++)
+        EXPECT_EQ(result[i].word, ranked[i].word);
+
+    // each list has its own cache file
+    EXPECT_TRUE(engine->saveCache());
+    EXPECT_TRUE(dictionaries.get("other")->saveCache());
+    EXPECT_TRUE(filesystem::exists(directory + "/entropy_cache_small.txt"));
+    EXPECT_TRUE(filesystem::exists(directory + "/entropy_cache_other.txt"));
+}
+
+TEST_F(SMALL_LISTS, TREE_SIMULATION)
+{
+    Wordle wordle(allowed, "crane", possible, cache);
+    Simulator sim(possible, wordle);
+    sim.setPointsPath(file("points"));
+    vector<string> outputs, points;
+    for (bool tree : { false, true })
+    {
+        testing::internal::CaptureStdout();
+        tree ? sim.runTree(3) : sim.run(3);
+        string output = testing::internal::GetCapturedStdout();
+        // the progress bars differ
+        outputs.push_back(output.substr(output.find("Average score")));
+        ifstream pointsFile(file("points"));
+        points.push_back(string(istreambuf_iterator<char>(pointsFile), {}));
+    }
+    EXPECT_EQ(outputs[0], outputs[1]);
+    EXPECT_EQ(points[0], points[1]);
+    EXPECT_FALSE(points[0].empty());
+}
+
+TEST_F(SMALL_LISTS, BATCHED_SIMULATION)
+{
+    // one game per batch and batches of several games give the same games
+    vector<string> outputs, points;
+    for (int batchSize : { 0, 1, 4, 64 })
+    {
+        // a fresh engine each time, so the games do not hit the cache
+        WordleRegression wordle(allowed, "crane", possible, cache);
+        Simulator sim(possible, wordle);
+        sim.setPointsPath(file("points"));
+        testing::internal::CaptureStdout();
+        batchSize ? sim.runBatched(3, batchSize) : sim.run(3);
+        string output = testing::internal::GetCapturedStdout();
+        outputs.push_back(output.substr(output.find("Average score")));
+        ifstream pointsFile(file("points"));
+        points.push_back(string(istreambuf_iterator<char>(pointsFile), {}));
+        filesystem::remove(cache);
+        filesystem::remove(CacheLog::logPath(cache));
+    }
+    for (int i = 1; i < outputs.size(); i++)
+    {
+        EXPECT_EQ(outputs[0], outputs[i]);
+        EXPECT_EQ(points[0], points[i]);
+    }
+    EXPECT_FALSE(points[0].empty());
+
+    // the requests of the turn are evaluated together once all are made
+    Wordle wordle(allowed, possible, cache);
+    BatchEvaluator evaluator(wordle);
+    vector<Wordle::Stat> states;
+    for (auto &target : { "crane", "fuzzy", "crane" })
+    {
+        auto game = wordle.clone();
+        game->setTargetWord(target);
+        states.push_back(game->guess("slate"));
+    }
+    evaluator.startTurn();
+    vector<int> ids = { 0, 1, 2 };
+    for (auto &stat : states)
+        EXPECT_THROW(evaluator.evaluate(stat, ids), BatchEvaluator::Pending);
+    EXPECT_TRUE(evaluator.flush());
+    EXPECT_FALSE(evaluator.flush());
+    EXPECT_EQ(evaluator.getPasses(), 1);
+    vector<vector<Wordle::Word>> results;
+    for (auto &stat : states) results.push_back(evaluator.evaluate(stat, ids));
+    // a guess is only evaluated for the states that asked for it
+    EXPECT_THROW(evaluator.evaluate(states[1], { 3 }), BatchEvaluator::Pending);
+    EXPECT_TRUE(evaluator.flush());
+    EXPECT_EQ(evaluator.evaluate(states[1], { 3 }).size(), 1);
+    EXPECT_THROW(evaluator.evaluate(states[0], { 1, 3 }), BatchEvaluator::Pending);
+    EXPECT_EQ(evaluator.getPasses(), 2);
+    for (int i = 0; i < states.size(); i++)
+    {
+        auto game = wordle.clone();
+        auto &stat = states[i];
+        ASSERT_EQ(results[i].size(), ids.size());
+        for (int k = 0; k < ids.size(); k++)
+        {
+            auto expected = game->getEntropy(stat, results[i][k].word);
+            EXPECT_EQ(results[i][k].id, ids[k]);
+            EXPECT_NEAR(results[i][k].entropy, expected.entropy, 1e-9);
+            EXPECT_NEAR(results[i][k].maxEntropy, expected.maxEntropy, 1e-9);
+        }
+    }
+}
+
+TEST_F(SMALL_LISTS, SHARDED_SIMULATION)
+{
+    Wordle wordle(allowed, "crane", possible, cache);
+    Simulator sim(possible, wordle);
+    sim.setPointsPath(file("points"));
+    testing::internal::CaptureStdout();
+    sim.runTree(3);
+    string whole = testing::internal::GetCapturedStdout();
+    ifstream wholeFile(file("points"));
+    string wholePoints(istreambuf_iterator<char>(wholeFile), {});
+
+    // the shards only write their games, in any order of completion
+    vector<string> partials;
+    for (int i : { 2, 0, 1 })
+    {
+        partials.push_back(file("shard_" + to_string(i), ".bin"));
+        sim.setShard(i, 3);
+        sim.setPointsPath("");
+        sim.setPartialPath(partials.back());
+        testing::internal::CaptureStdout();
+        i ? sim.run(3) : sim.runTree(3);
+        testing::internal::GetCapturedStdout();
+    }
+
+    testing::internal::CaptureStdout();
+    ASSERT_TRUE(Simulator::merge(partials, file("points_merged")));
+    string merged = testing::internal::GetCapturedStdout();
+    ifstream mergedFile(file("points_merged"));
+    string mergedPoints(istreambuf_iterator<char>(mergedFile), {});
+    EXPECT_EQ(whole.substr(whole.find("Average score")), merged);
+    EXPECT_EQ(wholePoints, mergedPoints);
+
+    // a shard twice is an error, a missing one a warning
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(Simulator::merge({ partials[0], partials[0] }, ""));
+    testing::internal::GetCapturedStderr();
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(Simulator::merge({ partials[0], partials[1] }, ""));
+    EXPECT_NE(testing::internal::GetCapturedStdout().find("MISSING SHARDS OF 3: 1\n"),
+              string::npos);
+
+    // a corrupt header is an error rather than a huge allocation
+    ifstream shardFile(partials[0], ios::binary);
+    string bytes(istreambuf_iterator<char>(shardFile), {});
+    // the size and the shard count follow the magic, version, list and seed
+    for (size_t offset : { 29, 37 })
+    {
+        string corrupt = bytes;
+        corrupt.replace(offset, 4, 4, '\xff');
+        ofstream(file("shard_corrupt", ".bin"), ios::binary) << corrupt;
+        testing::internal::CaptureStderr();
+        EXPECT_FALSE(Simulator::merge({ file("shard_corrupt", ".bin") }, ""));
+        testing::internal::GetCapturedStderr();
+    }
+
+    // shards of a run with another seed or another list are errors
+    auto shard = [&](Simulator &sim, const string &name) {
+        sim.setShard(1, 3);
+        sim.setPointsPath("");
+        sim.setPartialPath(file(name, ".bin"));
+        testing::internal::CaptureStdout();
+        sim.run(3);
+        testing::internal::GetCapturedStdout();
+        testing::internal::CaptureStderr();
+        bool merged = Simulator::merge(
+            { partials[0], partials[1], file(name, ".bin") }, "");
+        testing::internal::GetCapturedStderr();
+        return merged;
+    };
+    EXPECT_TRUE(shard(sim, "shard_again"));
+    sim.setSeed(7);
+    EXPECT_FALSE(shard(sim, "shard_seeded"));
+    writeWords(file("reversed"), vector<string>(words.rbegin(), words.rend()));
+    Simulator reversed(file("reversed"), wordle);
+    EXPECT_FALSE(shard(reversed, "shard_reversed"));
+
+    // a shard without targets plays nothing
+    sim.setShard(words.size(), words.size() + 1);
+    testing::internal::CaptureStdout();
+    sim.run(3);
+    EXPECT_NE(testing::internal::GetCapturedStdout().find("no games played"),
+              string::npos);
+
+    // the same seed draws the same targets
+    Wordle other(allowed, possible, cache);
+    wordle.setSeed(42);
+    other.setSeed(42);
+    for (int i = 0; i < 5; i++)
+    {
+        wordle.setRandomTargetWord();
+        other.setRandomTargetWord();
+        EXPECT_EQ(wordle.getTargetWord(), other.getTargetWord());
+    }
+}
+
+TEST_F(SMALL_LISTS, ENGINE_HARNESS)
+{
+    Wordle wordle(allowed, "crane", possible, cache);
+    WordleLoop loop(allowed, "crane", possible, cache);
+    WordleRegression regression(allowed, "crane", possible, cache);
+
+    // the loop engine is asked about a state before its latest one
+    wordle.guess("slate");
+    loop.guess("slate");
+    auto initial = wordle.getStat(0);
+    EXPECT_EQ(loop.getPatternsCounts("brick", initial.query),
+              wordle.getPatternsCounts("brick", initial.query));
+    EXPECT_EQ(loop.getQueryCount(initial.query), words.size());
+    EXPECT_EQ(loop.getStat(-1).count, wordle.getStat(-1).count);
+    // a guess outside the lists has no id, so no row in the loop's table
+    EXPECT_EQ(loop.getPatternsCounts("zzzzz", initial.query),
+              wordle.getPatternsCounts("zzzzz", initial.query));
+    {
+        WordleLoop unlisted(allowed, "crane", possible, cache);
+        Wordle reference(allowed, "crane", possible, cache);
+        EXPECT_EQ(unlisted.guess("zzzzz").count, reference.guess("zzzzz").count);
+        EXPECT_EQ(unlisted.getQueryCount(unlisted.getStat(-1).query),
+                  reference.getStat(-1).count);
+    }
+
+    EngineHarness harness;
+    harness.add("Wordle", wordle);
+    harness.add("WordleLoop", loop);
+    harness.add("WordleRegression", regression);
+    EXPECT_EQ(harness.runExhaustive({ "slate", "brick" }), 0);
+    EXPECT_EQ(harness.runRandom(100, 4, 7), 0);
+    EXPECT_TRUE(harness.getMismatches().empty());
+    for (auto &engine : harness.getThroughput())
+    {
+        EXPECT_GT(engine.states, words.size());
+        EXPECT_GT(engine.histograms, 0);
+    }
+
+    // copies share the possible words, an update reaches all of them
+    auto copy = loop.clone();
+    copy->reset();
+    auto counts = copy->getPatternsCounts("brick", initial.query);
+    EXPECT_GT(loop.updateWords({}, { "fuzzy" }), 0);
+    EXPECT_NE(loop.getPatternsCounts("brick", initial.query), counts);
+    EXPECT_EQ(copy->getPatternsCounts("brick", initial.query),
+              loop.getPatternsCounts("brick", initial.query));
+    EXPECT_EQ(copy->getQueryCount(initial.query), words.size() - 1);
+    // so the rankings they share stay those of the current words
+    copy->reset();
+    wordle.updateWords({}, { "fuzzy" });
+    wordle.reset();
+    auto top = copy->getTopNWords(3), expected = wordle.getTopNWords(3);
+    ASSERT_EQ(top.size(), expected.size());
+    for (int i = 0; i < top.size(); i++)
+    {
+        EXPECT_EQ(top[i].word, expected[i].word);
+        EXPECT_EQ(scoreKey(top[i].score), scoreKey(expected[i].score));
+    }
+}
+
+TEST_F(SMALL_LISTS, ANYTIME_RANKING)
+{
+    // enough words for several blocks of a limited ranking
+    vector<string> words;
+    set<string> seen;
+    for (uint32_t x = 12345; words.size() < 300;)
+    {
+        string word;
+        for (int i = 0; i < 5; i++)
+        {
+            x = x * 1103515245 + 12345;
+            word += "aeioulnrstcdhmp"[(x >> 16) % 15];
+        }
+        if (seen.insert(word).second) words.push_back(word);
+    }
+    writeLists(words);
+
+    Wordle fresh(allowed, words[0], "", cache);
+    auto stat = fresh.guess(words[1]);
+
+    // a stopped ranking only ranks the words evaluated before the stop
+    stop_source source;
+    int calls = 0;
+    auto game = fresh.clone();
+    game->setEvaluator([&](const Wordle::Stat &state, const vector<int> &ids) {
+        vector<Wordle::Word> result;
+        for (int id : ids)
+            result.push_back(fresh.getEntropy(state, fresh.getWordIndex().word(id)));
+        if (++calls == 1) source.request_stop();
+        return result;
+    });
+    bool exact = true;
+    auto never = chrono::steady_clock::time_point::max();
+    auto partial = game->getTopNWords(5, stat, never, source.get_token(), exact);
+    EXPECT_FALSE(exact);
+    EXPECT_EQ(calls, 1);
+    ASSERT_FALSE(partial.empty());
+    for (auto &word : partial)
+        EXPECT_NEAR(word.entropy, fresh.getEntropy(stat, word.word).entropy, 1e-9);
+
+    // it was not cached, the complete ranking is still made
+    game->getTopNWords(5, stat, never, source.get_token(), exact);
+    EXPECT_FALSE(exact);
+    game->setEvaluator(nullptr);
+    auto complete = game->getTopNWords(5, stat, never, stop_token(), exact);
+    EXPECT_TRUE(exact);
+    Wordle other(allowed, words[0], "", file("entropy_cache_other"));
+    auto unlimited = other.getTopNWords(5, other.guess(words[1]));
+    ASSERT_EQ(complete.size(), unlimited.size());
+    for (int i = 0; i < complete.size(); i++)
+        EXPECT_EQ(complete[i].word, unlimited[i].word);
+    EXPECT_LE(partial[0].entropy, complete[0].entropy + 1e-9);
+
+    // a deadline that has passed still answers from the cache
+    auto cached = game->getTopNWords(5, stat, chrono::steady_clock::now(),
+                                     stop_token(), exact);
+    EXPECT_TRUE(exact);
+    EXPECT_EQ(cached.size(), complete.size());
+}
+
+TEST_F(SMALL_LISTS, PRECOMPUTE)
+{
+    Wordle wordle(allowed, "grind", possible, cache);
+    auto isCached = [&](const Wordle::Stat &stat) {
+        // a stopped ranking is only exact if it was cached
+        stop_source stopped;
+        stopped.request_stop();
+        bool exact;
+        wordle.getTopNWords(3, stat, chrono::steady_clock::time_point::max(),
+                            stopped.get_token(), exact);
+        return exact;
+    };
+
+    // every pattern of the guess but the winning one, most likely first
+    Precomputer precomputer(wordle, 3, 2, 2);
+    precomputer.start("slate");
+    precomputer.wait();
+    EXPECT_EQ(precomputer.getRanked(), 2);
+    auto stat = wordle.guess("slate");
+    EXPECT_EQ(stat.pattern, "WWWWW");
+    EXPECT_TRUE(isCached(stat));
+
+    // less likely patterns were not ranked
+    auto copy = wordle.clone();
+    copy->reset();
+    copy->setTargetWord("sassy");
+    auto unlikely = copy->guess("slate");
+    EXPECT_FALSE(isCached(unlikely));
+
+    // a stopped precompute leaves nothing running
+    precomputer.start("brick");
+    precomputer.stop();
+    EXPECT_LE(precomputer.getRanked(), 2);
+    precomputer.start("notaword");
+    precomputer.wait();
+    EXPECT_EQ(precomputer.getRanked(), 0);
+}
+
+TEST_F(SMALL_LISTS, UPDATE_WORDS)
+{
+    const string rebuiltCache = file("entropy_cache_rebuilt");
+    vector<string> words;
+    set<string> seen;
+    for (uint32_t x = 54321; words.size() < 300;)
+    {
+        string word;
+        for (int i = 0; i < 5; i++)
+        {
+            x = x * 1103515245 + 12345;
+            word += "aeioulnrstcdhmp"[(x >> 16) % 15];
+        }
+        if (seen.insert(word).second) words.push_back(word);
+    }
+    vector<string> answers(words.begin(), words.begin() + 100);
+    writeLists(words, answers);
+
+    Wordle wordle(allowed, answers[0], possible, cache);
+    WordleLoop loop(allowed, answers[0], possible, "");
+    wordle.getTopNWords(5, wordle.guess(words[150]));
+    auto game = wordle.clone();
+    wordle.reset();
+    wordle.getTopNWords(5);
+
+    // the same words as an engine built from the changed lists
+    auto expectRebuilt = [&](Wordle &updated) {
+        writeLists(words, answers);
+        Wordle rebuilt(allowed, answers[0], possible, rebuiltCache);
+        EXPECT_EQ(updated.getStat(0).key, rebuilt.getStat(0).key);
+        EXPECT_EQ(updated.getStat(0).count, rebuilt.getStat(0).count);
+
+        map<string, Wordle::Word> ranking;
+        for (auto &word : *rebuilt.getRanking()) ranking[word.word] = word;
+        EXPECT_EQ(updated.getRanking()->size(), ranking.size());
+        for (auto &word : *updated.getRanking())
+        {
+            ASSERT_TRUE(ranking.contains(word.word)) << word.word;
+            EXPECT_NEAR(word.entropy, ranking[word.word].entropy, 1e-9);
+            EXPECT_NEAR(word.maxEntropy, ranking[word.word].maxEntropy, 1e-9);
+        }
+        // the games the updated engine played may have left another target
+        updated.setTargetWord(answers[0]);
+        for (auto &guess : { "", words[150].c_str() })
+        {
+            updated.reset(), rebuilt.reset();
+            if (*guess) updated.guess(guess), rebuilt.guess(guess);
+            auto expected = rebuilt.getTopNWords(5);
+            auto actual = updated.getTopNWords(5);
+            ASSERT_EQ(actual.size(), expected.size());
+            for (int i = 0; i < actual.size(); i++)
+                EXPECT_NEAR(actual[i].entropy, expected[i].entropy, 1e-9);
+        }
+        filesystem::remove(rebuiltCache);
+        filesystem::remove(CacheLog::logPath(rebuiltCache));
+    };
+
+    // two answers are dropped, three allowed words and a new word join
+    vector<string> added = { words[200], words[201], words[202], "zesty" },
+                   removed = { answers[1], answers[2] };
+    EXPECT_EQ(wordle.updateWords(added, removed), 6);
+    EXPECT_EQ(wordle.updateWords(added, removed), 0);
+    loop.updateWords(added, removed);
+    EXPECT_TRUE(wordle.isWordValid("zesty"));
+    answers.erase(answers.begin() + 1, answers.begin() + 3);
+    answers.insert(answers.end(), added.begin(), added.end());
+    words.push_back("zesty");
+    expectRebuilt(wordle);
+
+    // a game in progress keeps its words less the removed ones
+    auto before = game->getStat(-1);
+    auto stat = game->guess(words[160]);
+    int remaining = 0;
+    for (int id : game->getCandidateIds(stat))
+    {
+        string word = game->getWordIndex().word(id);
+        EXPECT_TRUE(game->isInWordSpace(id, before)) << word;
+        EXPECT_EQ(ranges::count(removed, word), 0) << word;
+        remaining++;
+    }
+    EXPECT_EQ(remaining, stat.count);
+    EXPECT_FALSE(game->getTopNWords(5, stat).empty());
+
+    // a guess that is no longer allowed leaves the rankings it was part of
+    string best = wordle.getTopNWords(1, wordle.getStat(0))[0].word;
+    EXPECT_EQ(wordle.updateWords({}, { best }, false), 1);
+    loop.updateWords({}, { best }, false);
+    EXPECT_FALSE(wordle.isWordValid(best));
+    erase(words, best);
+    erase(answers, best);
+    expectRebuilt(wordle);
+
+    // the cache file gets the new ranking, without waiting for the background
+    wordle.saveCache();
+    writeLists(words, answers);
+    Wordle reloaded(allowed, answers[0], possible, cache);
+    expectRebuilt(reloaded);
+
+    {
+        EngineHarness harness;
+        Wordle rebuilt(allowed, answers[0], possible, rebuiltCache);
+        harness.add("rebuilt", rebuilt);
+        harness.add("updated", wordle);
+        harness.add("loop", loop);
+        EXPECT_EQ(harness.runRandom(20), 0);
+    }
+    filesystem::remove(rebuiltCache);
+    filesystem::remove(CacheLog::logPath(rebuiltCache));
+
+    // copies keep playing while the words change under them
+    atomic<bool> done = false;
+    vector<thread> players;
+    for (int t = 0; t < 2; t++)
+        players.emplace_back([&done, copy = wordle.clone()] {
+            while (!done)
+            {
+                copy->reset();
+                while (!copy->isGameOver())
+                    copy->guess(copy->getTopNWords(1)[0].word);
+            }
+        });
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(wordle.updateWords({ "zonal" }, {}), 1);
+        EXPECT_EQ(wordle.updateWords({}, { "zonal" }), 1);
+    }
+    done = true;
+    for (auto &player : players) player.join();
+    // still allowed, it is only no longer the answer
+    words.push_back("zonal");
+    expectRebuilt(wordle);
+
+    // an update from a call that reads the words would wait for itself
+    auto reader = wordle.clone();
+    reader->guess("brick");
+    reader->setEvaluator([&](const Wordle::Stat &, const vector<int> &) {
+        reader->updateWords({ "zonal" }, {});
+        return vector<Wordle::Word>();
+    });
+    EXPECT_THROW(reader->getTopNWords(3), logic_error);
+}
+
+TEST_F(SMALL_LISTS, SHARED_CACHE)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const string name = "/wordle_solver_test_" + to_string(getpid());
+    shm_unlink(name.c_str());
+
+    // two mappings of one segment behave like two processes
+    SharedCache writer, reader, other;
+    ASSERT_TRUE(writer.open(name, 42, 100));
+    ASSERT_TRUE(reader.open(name, 42, 100));
+    EXPECT_FALSE(other.open(name, 7, 100));
+
+    int n;
+    vector<SharedCache::Record> words;
+    EXPECT_FALSE(reader.find("0123456789abcdef", n, words));
+    vector<SharedCache::Record> stored = { { 3, 1, 2.5, 2.5, 3.0 },
+                                           { 1, 2, 1.5, 1.5, 2.0 } };
+    ASSERT_TRUE(writer.store("0123456789abcdef", 5, stored));
+    ASSERT_TRUE(reader.find("0123456789abcdef", n, words));
+    EXPECT_EQ(n, 5);
+    ASSERT_EQ(words.size(), 2);
+    EXPECT_EQ(words[1].id, 1);
+    EXPECT_EQ(words[1].entropy, 1.5);
+    EXPECT_FALSE(writer.store("too many", 1, vector<SharedCache::Record>(17)));
+    // entries are told apart by the whole key
+    string longKey(SharedCache::maxKeyLength + 1, 'a');
+    EXPECT_FALSE(writer.store(longKey, 5, stored));
+    EXPECT_FALSE(reader.find("0123456789abcdef-sampled", n, words));
+
+    // engines with the same word lists share their rankings
+    const string engines = name + "_engines";
+    shm_unlink(engines.c_str());
+    Wordle first(allowed, "crane", possible, cache),
+        second(allowed, "crane", possible, cache);
+    ASSERT_TRUE(first.openSharedCache(engines));
+    ASSERT_TRUE(second.openSharedCache(engines));
+    auto expected = first.getTopNWords(3, first.guess("slate"));
+    auto result = second.getTopNWords(3, second.guess("slate"));
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); i++)
+    {
+        EXPECT_EQ(result[i].word, expected[i].word);
+        EXPECT_EQ(result[i].entropy, expected[i].entropy);
+    }
+
+    writeLists({ "crane", "crave" });
+    filesystem::remove(cache);
+    Wordle different(allowed, "crane", possible, cache);
+    EXPECT_FALSE(different.openSharedCache(engines));
+
+    shm_unlink(name.c_str());
+    shm_unlink(engines.c_str());
+#endif
+}
+
+TEST_F(SMALL_LISTS, CACHE_LOG)
+{
+    auto contains = [](const string &path, const string &text) {
+        ifstream file(path);
+        stringstream content;
+        content << file.rdbuf();
+        return content.str().find(text) != string::npos;
+    };
+
+    vector<Wordle::Word> expected;
+    string key;
+    uintmax_t snapshotSize;
+    {
+        Wordle wordle(allowed, "crane", possible, cache);
+        snapshotSize = filesystem::file_size(cache);
+        auto stat = wordle.guess("slate");
+        key = stat.key;
+        expected = wordle.getTopNWords(3, stat);
+    }
+
+    // appended to the log, the snapshot is left alone
+    EXPECT_EQ(filesystem::file_size(cache), snapshotSize);
+    EXPECT_TRUE(contains(CacheLog::logPath(cache), key + " 3 "));
+
+    // a crash can cut the last entry short
+    ofstream(CacheLog::logPath(cache), ios::app) << "0123456789abcdef 3 2\ncrane 1";
+
+    Wordle wordle(allowed, "crane", possible, cache);
+    auto result = wordle.getTopNWords(3, wordle.guess("slate"));
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); i++)
+        EXPECT_EQ(result[i].word, expected[i].word);
+
+    // compacting moves the log into the snapshot
+    ASSERT_TRUE(wordle.saveCache());
+    EXPECT_TRUE(contains(cache, key + " 3 "));
+    EXPECT_EQ(filesystem::file_size(CacheLog::logPath(cache)), 0);
+
+    // what another engine appended since survives the compaction
+    string otherKey;
+    {
+        Wordle other(allowed, "brick", possible, cache);
+        auto stat = other.guess("slate");
+        otherKey = stat.key;
+        other.getTopNWords(2, stat);
+    }
+    EXPECT_TRUE(contains(CacheLog::logPath(cache), otherKey + " 2 "));
+    ASSERT_TRUE(wordle.saveCache());
+    EXPECT_TRUE(contains(cache, key + " 3 "));
+    EXPECT_TRUE(contains(cache, otherKey + " 2 "));
+    for (auto &entry : filesystem::directory_iterator("."))
+        EXPECT_FALSE(entry.path().filename().string().starts_with(cache + ".tmp"));
+}
+
+TEST_F(SMALL_LISTS, CANDIDATE_IDS)
+{
+    writeLists({ "crane", "crave", "craze", "venge", "vezir", "slate" },
+               { "crane", "crave", "craze", "slate" });
+
+    Wordle wordle(allowed, "crane", possible, cache);
+    auto &index = wordle.getWordIndex();
+    vector<string> page;
+    for (int id : wordle.getCandidateIds(wordle.getStat(-1)) | views::drop(1) |
+                      views::take(2))
+        page.push_back(index.word(id));
+    EXPECT_EQ(page, vector<string>({ "crave", "craze" }));
+
+    auto stat = wordle.guess("slate");
+    vector<string> remaining;
+    for (int id : wordle.getCandidateIds(stat))
+        remaining.push_back(index.word(id));
+    EXPECT_EQ(remaining, wordle.getWords(-1));
+    EXPECT_EQ(remaining.size(), stat.count);
+}
+
+TEST(WORDLE, PATTERN_CODE)
+{
+    ifstream file("res/3b1b/allowed_words.txt");
+    ASSERT_TRUE(file.is_open());
+    vector<string> words;
+    string word;
+    while (file >> word) words.push_back(word);
+
+    // includes repeated letters on both sides, eg. "eerie" and "geese"
+    for (int i = 0; i < words.size(); i += 7)
+        for (int j = 0; j < words.size(); j += 97)
+        {
+            auto expected = Wordle::getPattern(words[i], words[j]);
+            int code = Wordle::getPatternCode(WordIndex<5>::pack(words[i]),
+                                              WordIndex<5>::pack(words[j]));
+            ASSERT_EQ(Wordle::getPattern(code), expected)
+                << words[i] << " " << words[j];
+            ASSERT_EQ(Wordle::getPatternCode(expected), code);
+        }
+}
+
+TEST(WORD_INDEX, INTERN)
+{
+    WordIndex<5> index({ "crane", "abbey", "zymic", "crane", "12345", "worlds" });
+    ASSERT_EQ(index.size(), 3);
+
+    // ids follow alphabetical order
+    EXPECT_EQ(index.id("abbey"), 0);
+    EXPECT_EQ(index.id("crane"), 1);
+    EXPECT_EQ(index.id("zymic"), 2);
+    EXPECT_EQ(index.word(1), "crane");
+
+    EXPECT_EQ(index.id("crave"), -1);
+    EXPECT_EQ(index.id("worlds"), -1);
+    EXPECT_EQ(index.id("...ij"), -1);
+    EXPECT_EQ(index.id(""), -1);
+
+    EXPECT_LT(WordIndex<5>::pack("aahed"), WordIndex<5>::pack("aalii"));
+    EXPECT_EQ(WordIndex<5>::unpack(WordIndex<5>::pack("zymic")), "zymic");
+    EXPECT_EQ(WordIndex<5>::letter(WordIndex<5>::pack("zymic"), 0), 25);
+}
+
+TEST(PARALLEL, THREAD_BUDGET)
+{
+    int budget = threadBudget;
+    threadBudget = 4;
+    // two threads of an outer loop leave two for each nested loop
+    vector<int> outer(2), inner(2);
+    parallelFor(2, 1 << 20, [&](int i) {
+        outer[i] = threadBudget;
+        parallelFor(4, 1 << 20,
+                    [&](int) { inner[i] = max(inner[i], threadBudget); });
+    });
+    EXPECT_EQ(outer, vector<int>({ 2, 2 }));
+    EXPECT_EQ(inner, vector<int>({ 1, 1 }));
+    EXPECT_EQ(threadBudget, 4);
+
+    // a loop too small for threads passes the whole budget down
+    parallelFor(2, 1, [&](int i) { outer[i] = threadBudget; });
+    EXPECT_EQ(outer, vector<int>({ 4, 4 }));
+    threadBudget = budget;
+}
+
 TEST(TRIE, COUNT)
 {
     ifstream file(filepath);
@@ -365,6 +1498,193 @@ TEST(TRIE, NTH_WORD)
     EXPECT_EQ(trie.getNthWord(12345, ID), "state");
     EXPECT_EQ(trie.getNthWord(14855, ID), "zymic");
 }
+TEST(TRIE, FOR_EACH)
+{
+    ifstream file("res/3b1b/allowed_words.txt");
+    ASSERT_TRUE(file.is_open());
+
+    Trie<5> trie;
+    auto ID = Trie<5>::ID::ALLOWED;
+    string word;
+    while (file >> word) trie.insert(word, ID);
+
+    auto query = trie.query(".a.a.", ID);
+    query.include('b');
+    query.exclude('s');
+    vector<string> expected;
+    int count = trie.count(query, &expected);
+
+    vector<string> visited;
+    EXPECT_EQ(trie.forEach(query,
+                           [&visited](string_view word) {
+                               visited.emplace_back(word);
+                               return true;
+                           }),
+              count);
+    EXPECT_EQ(visited, expected);
+
+    // stops after the visitor says so
+    visited.clear();
+    EXPECT_EQ(trie.forEach(trie.query("", ID),
+                           [&visited](string_view word) {
+                               visited.emplace_back(word);
+                               return visited.size() < 3;
+                           }),
+              3);
+    EXPECT_EQ(visited, vector<string>({ "aahed", "aalii", "aargh" }));
+}
+
+TEST(TRIE, LIVE)
+{
+    vector<string> words = { "beisa", "fossa", "plush", "queck",
+                             "rossa", "sputa", "squad", "camus" };
+    Trie<5> trie;
+    auto ID = Trie<5>::ID::ALLOWED;
+    for (auto &w : words) trie.insert(w, ID);
+
+    // eliminate everything but the words ending in "a"
+    auto live = trie.getLive();
+    for (auto &w : words) trie.setLive(w, live, 1);
+    for (auto &w : { "plush", "queck", "squad", "camus" })
+        trie.setLive(w, live, -1);
+
+    auto query = trie.query("", ID);
+    vector<string> result;
+    EXPECT_EQ(trie.count(query, &result, &live), 4);
+    EXPECT_EQ(result, vector<string>({ "beisa", "fossa", "rossa", "sputa" }));
+
+    query.include('s');
+    vector<string> visited;
+    trie.forEach(
+        query,
+        [&visited](string_view word) {
+            visited.emplace_back(word);
+            return true;
+        },
+        &live);
+    EXPECT_EQ(visited, result);
+
+    auto all = trie.query("", ID);
+    unordered_map<string, int> expected = { { "WMWMM", 1 }, { "WMWWM", 3 } };
+    EXPECT_EQ(trie.getPatternsCounts("camus", all, &live), expected);
+}
+
+TEST(TRIE, REMOVE)
+{
+    vector<string> words = { "beisa", "fossa", "plush", "queck",
+                             "rossa", "sputa", "squad", "camus" };
+    Trie<5> trie, expected;
+    auto ID = Trie<5>::ID::ALLOWED;
+    for (auto &w : words) trie.insert(w, ID);
+    auto live = trie.getLive();
+    for (auto &w : words) trie.setLive(w, live, 1);
+
+    int version = trie.getVersion();
+    EXPECT_TRUE(trie.remove("fossa", ID));
+    EXPECT_TRUE(trie.remove("squad", ID));
+    EXPECT_FALSE(trie.remove("squad", ID));
+    EXPECT_FALSE(trie.remove("plush", Trie<5>::ID::POSSIBLE));
+    EXPECT_NE(trie.getVersion(), version);
+    for (auto &w : words)
+        if (w != "fossa" && w != "squad") expected.insert(w, ID);
+
+    // the counts and masks are the same as if the words were never there
+    auto query = trie.query("", ID);
+    vector<vector<string>> results(2);
+    for (int i = 0; i < 3; i++)
+    {
+        if (i == 1) query.include('s');
+        if (i == 2) query.setMisplaced('s', 0);
+        EXPECT_EQ(trie.count(query, &results[0]),
+                  expected.count(query, &results[1]));
+        EXPECT_EQ(results[0], results[1]);
+        EXPECT_EQ(trie.getPatternsCounts("sassy", query),
+                  expected.getPatternsCounts("sassy", query));
+    }
+
+    // live counts built before still skip the removed words, and the words
+    // inserted after
+    trie.insert("zesty", ID);
+    auto all = trie.query("", ID);
+    EXPECT_EQ(trie.count(all), 7);
+    EXPECT_EQ(trie.count(all, nullptr, &live), 6);
+}
+
+TEST(TRIE, BULK_INSERT)
+{
+    ifstream file("res/3b1b/allowed_words.txt");
+    ASSERT_TRUE(file.is_open());
+    vector<string> allowed, possible;
+    string word;
+    while (file >> word) allowed.push_back(word);
+    // unsorted, with a word of its own and a duplicate
+    for (int i = allowed.size() - 1; i >= 0; i -= 7) possible.push_back(allowed[i]);
+    possible.push_back("zzzzz"), possible.push_back(possible[0]);
+
+    auto ALLOWED = Trie<5>::ID::ALLOWED, POSSIBLE = Trie<5>::ID::POSSIBLE;
+    Trie<5> bulk, expected;
+    bulk.insert(allowed, ALLOWED);
+    bulk.insert(possible, POSSIBLE);
+    for (auto &w : allowed) expected.insert(w, ALLOWED);
+    for (auto &w : possible) expected.insert(w, POSSIBLE);
+    EXPECT_EQ(bulk.getNodeCount(), expected.getNodeCount());
+
+    // the same counts and masks as inserting the words one by one
+    for (auto id : { ALLOWED, POSSIBLE })
+    {
+        auto queries = vector<Trie<5>::Query>(5, bulk.query("", id));
+        queries[1].parse("s...."), queries[1].include('e', 2);
+        queries[2].include('a'), queries[2].setMisplaced('a', 2);
+        queries[3].exclude('e'), queries[3].exclude('s');
+        queries[4].include('z', 2);
+        for (auto &query : queries)
+        {
+            vector<vector<string>> results(2);
+            EXPECT_EQ(bulk.count(query, &results[0]),
+                      expected.count(query, &results[1]));
+            EXPECT_EQ(results[0], results[1]);
+            for (auto &guess : { "soare", "zzzzz", "eerie" })
+                EXPECT_EQ(bulk.getPatternsCounts(guess, query),
+                          expected.getPatternsCounts(guess, query));
+        }
+    }
+    EXPECT_EQ(bulk.count(possible[0], POSSIBLE), 2);
+
+    // every node has its own place in the live counts
+    auto live = bulk.getLive();
+    for (auto &w : { "crane", "zzzzz" }) bulk.setLive(w, live, 1);
+    EXPECT_EQ(bulk.count(bulk.query("", POSSIBLE), nullptr, &live), 1);
+    EXPECT_EQ(bulk.count(bulk.query("", ALLOWED), nullptr, &live), 1);
+}
+
+TEST(TRIE, PRUNE)
+{
+    ifstream file("res/3b1b/allowed_words.txt");
+    ASSERT_TRUE(file.is_open());
+
+    Trie<5> trie;
+    auto ID = Trie<5>::ID::ALLOWED;
+    vector<string> words;
+    string word;
+    while (file >> word) trie.insert(word, ID), words.push_back(word);
+
+    // every pruning rule must keep exactly the words the query accepts
+    auto queries = vector<Trie<5>::Query>(6, trie.query("", ID));
+    queries[0].parse("..a..");
+    queries[1].include('e', 2);
+    queries[2].include('s'), queries[2].setMisplaced('s', 0);
+    queries[3].setMisplaced('r', 4), queries[3].include('r');
+    queries[4].exclude('e'), queries[4].exclude('a');
+    queries[5].parse("s...."), queries[5].include('s', 2);
+    queries[5].setMisplaced('t', 1), queries[5].include('t');
+    for (auto &query : queries)
+    {
+        int expected = 0;
+        for (auto &w : words) expected += query.verify(w);
+        EXPECT_EQ(trie.count(query), expected);
+    }
+}
+
 TEST(TRIE, PATTERNCOUNTS1)
 {
     string guess = "camus";
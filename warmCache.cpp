@@ -0,0 +1,32 @@
+#include <iostream>
+#include <string>
+#include "cacheWarmer.h"
+#include "wordleRegression.h"
+
+using namespace std;
+const string allowedFilepath = "res/3b1b/allowed_words.txt";
+const string possibleFilepath = "res/3b1b/possible_words.txt";
+const string cacheFilepath = "entropy_cache.txt";
+
+// Usage: WarmCache [words per state = 100] [guesses = 2] [cache file]
+// Ranks every state the solver can reach within the given number of guesses
+// and writes them to the cache file the solver loads on start up
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? stoi(argv[1]) : 100;
+    int depth = argc > 2 ? stoi(argv[2]) : 2;
+    string cachePath = argc > 3 ? argv[3] : cacheFilepath;
+
+    // the same engine as the solver, so its policy picks the guesses
+    WordleRegression wordle(allowedFilepath, possibleFilepath, cachePath);
+    CacheWarmer warmer(wordle);
+    int states = warmer.run(n, depth);
+
+    if (!wordle.saveCache())
+    {
+        cerr << "Error writing cache file: " << cachePath << endl;
+        return 1;
+    }
+    cout << "Ranked " << states << " states into " << cachePath << endl;
+    return 0;
+}